@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "bake.hpp"
+#include "density.hpp"
+#include "primitives.hpp"
+#include "util.hpp"
+
+namespace bake
+{
+
+namespace
+{
+
+// Bump when the baking itself changes, so older caches are not picked up
+constexpr std::uint32_t bake_version{2};
+
+} // namespace
+
+grid::GridFile bake_fbm(const primitives::Sphere& sphere, int resolution, const perlin::FbmParameters& fbm)
+{
+    const glm::vec3 extent{sphere.radius};
+    const std::array<glm::vec3, 2> bounds{sphere.center - extent, sphere.center + extent};
+    const glm::vec3 voxel_size{(bounds[1] - bounds[0]) / static_cast<float>(resolution)};
+
+    const perlin::Fbm noise{fbm};
+    std::vector<float> values(static_cast<std::size_t>(resolution) * resolution * resolution);
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < resolution; ++z)
+    {
+        // One row of voxel centres at a time, so the noise runs over full batches
+        std::vector<float> row_x(resolution);
+        std::vector<float> row_y(resolution);
+        std::vector<float> row_z(resolution);
+        for (int y = 0; y < resolution; ++y)
+        {
+            for (int x = 0; x < resolution; ++x)
+            {
+                const glm::vec3 position{bounds[0] + (glm::vec3{glm::ivec3{x, y, z}} + 0.5f) * voxel_size};
+                row_x[x] = position.x;
+                row_y[x] = position.y;
+                row_z[x] = position.z;
+            }
+
+            float* row{values.data() + (static_cast<std::size_t>(z) * resolution + y) * resolution};
+            density::eval_fbm(row_x.data(), row_y.data(), row_z.data(), row, resolution, sphere.center, sphere.radius,
+                              noise);
+            for (int x = 0; x < resolution; ++x)
+            {
+                if (glm::length(glm::vec3{row_x[x], row_y[x], row_z[x]} - sphere.center) > sphere.radius)
+                {
+                    row[x] = 0.0f;
+                }
+            }
+        }
+    }
+
+    grid::GridFile file{};
+    file.bounds = bounds;
+    file.channels.push_back(
+        grid::GridChannel{.name = "density", .grid = grid::SparseGrid::from_dense(values, resolution)});
+    return file;
+}
+
+std::string fbm_cache_filename(const std::string& directory, const primitives::Sphere& sphere, int resolution,
+                               const perlin::FbmParameters& fbm)
+{
+    std::uint64_t hash{perlin::parameters_hash(fbm)};
+    hash = util::hash_bytes(&bake_version, sizeof(bake_version), hash);
+    hash = util::hash_bytes(&resolution, sizeof(resolution), hash);
+    hash = util::hash_bytes(&sphere.radius, sizeof(sphere.radius), hash);
+    hash = util::hash_bytes(&sphere.center, sizeof(sphere.center), hash);
+
+    std::ostringstream filename;
+    filename << "fbm." << resolution << '.' << std::hex << std::setw(16) << std::setfill('0') << hash
+             << grid::grid_file_extension;
+    return (std::filesystem::path{directory} / filename.str()).string();
+}
+
+void load_or_bake_fbm(primitives::Box& box, const primitives::Sphere& sphere, int resolution,
+                      const perlin::FbmParameters& fbm, const std::string& cache_directory)
+{
+    const std::string filename{fbm_cache_filename(cache_directory, sphere, resolution, fbm)};
+    if (std::filesystem::exists(filename))
+    {
+        try
+        {
+            box.load_density(filename);
+            return;
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << "Baking again over unreadable density cache " << filename << ": " << error.what() << '\n';
+        }
+    }
+
+    const grid::GridFile file{bake_fbm(sphere, resolution, fbm)};
+    // Written under a name of its own and renamed into place, so that neither a crash mid-write nor
+    // another process baking the same grid leaves a partial file under the cache name
+    std::filesystem::path temporary{filename};
+    std::ostringstream suffix;
+    suffix << '.' << std::hex << std::random_device{}() << ".tmp" << grid::grid_file_extension;
+    temporary.replace_extension(suffix.str());
+    try
+    {
+        std::filesystem::create_directories(cache_directory);
+        grid::write_grid_file(temporary.string(), file);
+        std::filesystem::rename(temporary, filename);
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "Failed to cache baked density: " << error.what() << '\n';
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        box.bounds = file.bounds;
+        box.set_density(file.channel("density"));
+        return;
+    }
+    box.load_density(filename);
+}
+
+} // namespace bake
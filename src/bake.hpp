@@ -0,0 +1,44 @@
+#ifndef BAKE_HPP
+#define BAKE_HPP
+
+#include <string>
+
+#include "grid_file.hpp"
+#include "perlin.hpp"
+
+// Forward declarations
+namespace primitives
+{
+
+struct Box;
+struct Sphere;
+
+} // namespace primitives
+
+namespace bake
+{
+
+/*
+
+Bakes procedural densities into voxel grids, so procedural scenes render through the same
+grid lookups as the cached fluid simulations instead of evaluating noise per sample.
+
+The FBM sphere is sampled at the voxel centres of a resolution^3 grid spanning the sphere's
+bounding cube, zero outside the sphere. Baked grids are cached as .vgrid files whose names
+hash everything the values depend on, so a parameter change never reuses a stale cache.
+
+*/
+
+grid::GridFile bake_fbm(const primitives::Sphere& sphere, int resolution, const perlin::FbmParameters& fbm);
+
+std::string fbm_cache_filename(const std::string& directory, const primitives::Sphere& sphere, int resolution,
+                               const perlin::FbmParameters& fbm);
+
+// Loads the baked grid into box from the cache directory, baking and writing it first if it is
+// missing or unreadable. Failing to write the cache is reported on stderr but does not stop the render.
+void load_or_bake_fbm(primitives::Box& box, const primitives::Sphere& sphere, int resolution,
+                      const perlin::FbmParameters& fbm, const std::string& cache_directory = "cachefiles");
+
+} // namespace bake
+
+#endif // BAKE_HPP
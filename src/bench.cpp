@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <SFML/System/Vector2.hpp>
+#include <glm/glm.hpp>
+
+#include "context.hpp"
+#include "density.hpp"
+#include "perlin.hpp"
+#include "phase.hpp"
+#include "primitives.hpp"
+#include "random_gen.hpp"
+#include "ray.hpp"
+#include "sampler.hpp"
+#include "scene_tracer.hpp"
+#include "sparse_grid.hpp"
+#include "volume.hpp"
+
+/*
+
+Micro benchmarks of the per-sample building blocks and frame benchmarks of every chapter tracer.
+Results are written as JSON, one entry per benchmark with its mean and fastest time, so runs of
+different versions can be compared. Frames render chapters 5 and 6 from a synthetic 128^3 grid and
+the others from the default sphere; no cache file is read. Every frame traces in full, without the
+geometry cache of render::Context.
+
+Settings are "--key value" command line arguments:
+    filter      only run benchmarks whose name contains this text
+    output      JSON file, - for the standard output (default)
+    min_time    seconds each benchmark runs at least (default 0.5)
+    resolutions frame sizes, comma separated WIDTHxHEIGHT (default 160x120,320x240,640x480)
+    threads     thread counts of the frame benchmarks, comma separated; 0 is the OpenMP default (default 1,0)
+
+*/
+
+struct Options
+{
+    std::string filter{};
+    std::string output{"-"};
+    double min_time{0.5};
+    std::vector<sf::Vector2u> resolutions{{160, 120}, {320, 240}, {640, 480}};
+    std::vector<int> threads{1, 0};
+};
+
+struct Result
+{
+    std::string name;
+    std::string group;
+    std::uint64_t iterations{0};
+    // Per iteration: one call for micro benchmarks, one frame for frame benchmarks
+    double mean_ns{0.0};
+    double min_ns{0.0};
+};
+
+// Keeps benchmarked results alive so the optimizer cannot drop the calls producing them
+volatile float sink{0.0f};
+
+std::vector<std::string> split(const std::string& text, char separator)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream{text};
+    std::string part;
+    while (std::getline(stream, part, separator))
+    {
+        parts.push_back(part);
+    }
+    return parts;
+}
+
+Options parse_options(const std::vector<std::string>& arguments)
+{
+    Options options{};
+    for (std::size_t i = 0; i < arguments.size(); i += 2)
+    {
+        if (!arguments[i].starts_with("--") || i + 1 >= arguments.size())
+        {
+            throw std::invalid_argument{"Expected --key value, got: " + arguments[i]};
+        }
+
+        const std::string key{arguments[i].substr(2)};
+        const std::string& value{arguments[i + 1]};
+        if (key == "filter")
+        {
+            options.filter = value;
+        }
+        else if (key == "output")
+        {
+            options.output = value;
+        }
+        else if (key == "min_time")
+        {
+            options.min_time = std::stod(value);
+        }
+        else if (key == "resolutions")
+        {
+            options.resolutions.clear();
+            for (const std::string& resolution : split(value, ','))
+            {
+                const std::size_t separator{resolution.find('x')};
+                if (separator == std::string::npos)
+                {
+                    throw std::invalid_argument{"Expected WIDTHxHEIGHT, got: " + resolution};
+                }
+                const auto width{static_cast<unsigned int>(std::stoul(resolution.substr(0, separator)))};
+                const auto height{static_cast<unsigned int>(std::stoul(resolution.substr(separator + 1)))};
+                options.resolutions.emplace_back(width, height);
+            }
+        }
+        else if (key == "threads")
+        {
+            options.threads.clear();
+            for (const std::string& count : split(value, ','))
+            {
+                options.threads.push_back(std::stoi(count));
+            }
+        }
+        else
+        {
+            throw std::invalid_argument{"Unknown setting " + key};
+        }
+    }
+    return options;
+}
+
+// Calls run_batch, which performs batch_size iterations, until min_time has passed (after one untimed warm-up)
+Result measure(const std::string& name, const std::string& group, std::uint64_t batch_size, double min_time,
+               const std::function<void()>& run_batch)
+{
+    using clock = std::chrono::steady_clock;
+    run_batch();
+
+    Result result{.name = name, .group = group, .min_ns = std::numeric_limits<double>::infinity()};
+    std::chrono::duration<double, std::nano> total{0.0};
+    std::uint64_t batches{0};
+    while (total.count() < min_time * 1e9 || batches < 3)
+    {
+        const auto start{clock::now()};
+        run_batch();
+        const std::chrono::duration<double, std::nano> elapsed{clock::now() - start};
+        total += elapsed;
+        ++batches;
+        result.min_ns = std::min(result.min_ns, elapsed.count() / static_cast<double>(batch_size));
+    }
+
+    result.iterations = batches * batch_size;
+    result.mean_ns = total.count() / static_cast<double>(result.iterations);
+    std::cerr << std::left << std::setw(48) << name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(1) << result.mean_ns << " ns\n";
+    return result;
+}
+
+// Ball of smooth density with some variation, in a cube of resolution^3 voxels
+grid::SparseGrid synthetic_grid(int resolution)
+{
+    std::vector<float> values(static_cast<std::size_t>(resolution) * resolution * resolution, 0.0f);
+    const float center{0.5f * static_cast<float>(resolution)};
+    const float radius{0.4f * static_cast<float>(resolution)};
+    for (int z = 0; z < resolution; ++z)
+    {
+        for (int y = 0; y < resolution; ++y)
+        {
+            for (int x = 0; x < resolution; ++x)
+            {
+                const glm::vec3 offset{glm::vec3{glm::ivec3{x, y, z}} - center};
+                const float falloff{1.0f - glm::length(offset) / radius};
+                if (falloff > 0.0f)
+                {
+                    const float variation{0.5f + 0.5f * std::sin(0.3f * x) * std::cos(0.2f * y) * std::sin(0.25f * z)};
+                    values[(static_cast<std::size_t>(z) * resolution + y) * resolution + x] = falloff * variation;
+                }
+            }
+        }
+    }
+    return grid::SparseGrid::from_dense(values, resolution);
+}
+
+void run_micro_benchmarks(const Options& options, std::vector<Result>& results)
+{
+    constexpr std::size_t count{4096};
+    randomgen::Generator generator{0};
+    const auto random_vec3 = [&](float low, float high)
+    {
+        return glm::vec3{generator.random_float(low, high), generator.random_float(low, high),
+                         generator.random_float(low, high)};
+    };
+
+    const primitives::Sphere sphere{};
+    primitives::Box box{};
+    box.set_density(synthetic_grid(128));
+
+    // Rays from the camera towards the sphere and the box, about half of which hit
+    const glm::vec3 box_camera{0.0f, 0.0f, 200.0f};
+    std::vector<geometry::Ray> sphere_rays(count);
+    std::vector<geometry::Ray> box_rays(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sphere_rays[i] = geometry::Ray{.origin = glm::vec3{0.0f},
+                                       .direction = glm::normalize(sphere.center + random_vec3(-7.0f, 7.0f))};
+        box_rays[i] = geometry::Ray{.origin = box_camera,
+                                    .direction = glm::normalize(random_vec3(-70.0f, 70.0f) - box_camera)};
+        box_rays[i].compute_inv_direction();
+    }
+
+    std::vector<glm::vec3> box_positions(count);
+    std::vector<glm::vec3> sphere_positions(count);
+    std::vector<float> values(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        box_positions[i] = random_vec3(-50.0f, 50.0f);
+        sphere_positions[i] = sphere.center + random_vec3(-sphere.radius, sphere.radius);
+        values[i] = generator.random_float(-1.0f, 1.0f);
+    }
+
+    std::vector<float> x(count);
+    std::vector<float> y(count);
+    std::vector<float> z(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        x[i] = sphere_positions[i].x;
+        y[i] = sphere_positions[i].y;
+        z[i] = sphere_positions[i].z;
+    }
+    const perlin::Fbm noise{perlin::FbmParameters{}};
+
+    std::vector<std::pair<std::string, std::function<void()>>> benchmarks;
+    benchmarks.emplace_back("micro/sphere_intersect",
+                            [&]
+                            {
+                                float sum{0.0f};
+                                for (const geometry::Ray& ray : sphere_rays)
+                                {
+                                    primitives::HitRecord record;
+                                    sum += sphere.intersect(ray, record) ? record.max_root : 0.0f;
+                                }
+                                sink = sum;
+                            });
+    benchmarks.emplace_back("micro/box_intersect",
+                            [&]
+                            {
+                                float sum{0.0f};
+                                for (const geometry::Ray& ray : box_rays)
+                                {
+                                    primitives::HitRecord record;
+                                    sum += box.intersect(ray, record) ? record.max_root : 0.0f;
+                                }
+                                sink = sum;
+                            });
+    for (const auto& [filter, filter_name] : {std::pair{sampler::Filter::Nearest, "nearest"},
+                                              std::pair{sampler::Filter::Trilinear, "trilinear"},
+                                              std::pair{sampler::Filter::Tricubic, "tricubic"}})
+    {
+        benchmarks.emplace_back(std::string{"micro/eval_grid/"} + filter_name,
+                                [&, filter]
+                                {
+                                    box.set_filter(filter);
+                                    float sum{0.0f};
+                                    for (const glm::vec3& position : box_positions)
+                                    {
+                                        sum += density::eval_grid(position, box);
+                                    }
+                                    sink = sum;
+                                });
+    }
+    benchmarks.emplace_back("micro/eval_fbm",
+                            [&]
+                            {
+                                float sum{0.0f};
+                                for (const glm::vec3& position : sphere_positions)
+                                {
+                                    sum += density::eval_fbm(position, sphere.center, sphere.radius, noise);
+                                }
+                                sink = sum;
+                            });
+    benchmarks.emplace_back("micro/eval_fbm_batch",
+                            [&]
+                            {
+                                std::vector<float> densities(count);
+                                density::eval_fbm(x.data(), y.data(), z.data(), densities.data(),
+                                                  static_cast<int>(count), sphere.center, sphere.radius, noise);
+                                sink = densities[count / 2];
+                            });
+    benchmarks.emplace_back("micro/henyey_greenstein",
+                            [&]
+                            {
+                                float sum{0.0f};
+                                for (const float cos_theta : values)
+                                {
+                                    sum += phase::henyey_greenstein(0.3f, cos_theta);
+                                }
+                                sink = sum;
+                            });
+    benchmarks.emplace_back("micro/beer_lambert_transmittance",
+                            [&]
+                            {
+                                float sum{0.0f};
+                                for (const float distance : values)
+                                {
+                                    sum += volume::beer_lambert_transmittance(std::abs(distance) * 10.0f, 0.5f);
+                                }
+                                sink = sum;
+                            });
+
+    for (const auto& [name, run_batch] : benchmarks)
+    {
+        if (name.find(options.filter) != std::string::npos)
+        {
+            results.push_back(measure(name, "micro", count, options.min_time, run_batch));
+        }
+    }
+}
+
+void run_frame_benchmarks(const Options& options, std::vector<Result>& results)
+{
+    const primitives::Sphere sphere{};
+    primitives::Box box{};
+    box.set_density(synthetic_grid(128));
+    const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
+    // Chapter 4 bakes its noise once; keep that cache out of the working directory
+    const std::string bake_directory{(std::filesystem::temp_directory_path() / "volume-rendering-bench").string()};
+    int default_threads{1};
+#ifdef _OPENMP
+    default_threads = omp_get_max_threads();
+#endif
+
+    for (int chapter = 0; chapter < static_cast<int>(scene::Chapters::NumberOfChapters); ++chapter)
+    {
+        const auto chapter_id{static_cast<scene::Chapters>(chapter)};
+        const bool uses_box{chapter_id == scene::Chapters::VolumeVoxelGrid ||
+                            chapter_id == scene::Chapters::VolumeDeltaTracking};
+        for (const sf::Vector2u& resolution : options.resolutions)
+        {
+            for (const int threads : options.threads)
+            {
+                const std::string name{"frame/chapter" + std::to_string(chapter + 1) + "/" +
+                                       std::to_string(resolution.x) + "x" + std::to_string(resolution.y) +
+                                       "/threads:" + (threads > 0 ? std::to_string(threads) : "default")};
+                if (name.find(options.filter) == std::string::npos)
+                {
+                    continue;
+                }
+
+#ifdef _OPENMP
+                omp_set_num_threads(threads > 0 ? threads : default_threads);
+#endif
+                render::Context context{resolution};
+                context.set_output({.enabled = false});
+                context.set_geometry_caching(false);
+                scene::Tracer tracer{scene::make_tracer_variant(chapter_id)};
+                if (auto* density_field = std::get_if<scene::VolumeDensityField>(&tracer))
+                {
+                    density_field->bake_cache_directory = bake_directory;
+                }
+                results.push_back(measure(name, "frame", 1, options.min_time,
+                                          [&]
+                                          {
+                                              if (uses_box)
+                                              {
+                                                  context.render_image(ray_origin, box, tracer);
+                                              }
+                                              else
+                                              {
+                                                  context.render_image(ray_origin, sphere, tracer);
+                                              }
+                                          }));
+            }
+        }
+    }
+}
+
+std::string json_escape(const std::string& text)
+{
+    std::string escaped;
+    for (const char character : text)
+    {
+        if (character == '"' || character == '\\')
+        {
+            escaped += '\\';
+        }
+        escaped += character;
+    }
+    return escaped;
+}
+
+void write_json(std::ostream& stream, const std::vector<Result>& results)
+{
+    const std::time_t now{std::time(nullptr)};
+    int processors{1};
+#ifdef _OPENMP
+    processors = omp_get_num_procs();
+#endif
+#ifdef NDEBUG
+    const char* build{"release"};
+#else
+    const char* build{"debug"};
+#endif
+
+    stream << "{\n  \"context\": {\n"
+           << "    \"date\": \"" << std::put_time(std::gmtime(&now), "%Y-%m-%dT%H:%M:%SZ") << "\",\n"
+           << "    \"processors\": " << processors << ",\n"
+           << "    \"build\": \"" << build << "\"\n  },\n  \"benchmarks\": [";
+    stream << std::setprecision(6) << std::defaultfloat;
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& result{results[i]};
+        stream << (i > 0 ? "," : "") << "\n    {\"name\": \"" << json_escape(result.name) << "\", \"group\": \""
+               << result.group << "\", \"iterations\": " << result.iterations << ", \"mean_ns\": " << result.mean_ns
+               << ", \"min_ns\": " << result.min_ns << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const Options options{parse_options(std::vector<std::string>(argv + 1, argv + argc))};
+        std::vector<Result> results;
+        run_micro_benchmarks(options, results);
+        run_frame_benchmarks(options, results);
+
+        if (options.output == "-")
+        {
+            write_json(std::cout, results);
+        }
+        else
+        {
+            std::ofstream stream{options.output};
+            if (!stream)
+            {
+                throw std::runtime_error{"Failed to open output file " + options.output};
+            }
+            write_json(stream, results);
+        }
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+}
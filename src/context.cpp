@@ -1,96 +1,569 @@
-#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
 #include <stdexcept>
+#include <utility>
+#include <variant>
 
 #include <glm/gtx/transform.hpp>
 
 #include "context.hpp"
+#include "random_gen.hpp"
 #include "scene_tracer.hpp"
+#include "stats.hpp"
 #include "util.hpp"
 
 namespace render
 {
 
+namespace
+{
+
+constexpr std::uint32_t adaptive_tile_size{4};
+// Upper bound of the geometry cache, 128 MB of nodes
+constexpr std::size_t max_cached_nodes{std::size_t{1} << 25};
+
+template <typename Tracer>
+concept CachesGeometry = requires(const Tracer& tracer, const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                  float* nodes, randomgen::Generator& generator) {
+    { tracer.geometry_key(sphere) } -> std::same_as<scene::GeometryKey>;
+    { tracer.ray_geometry(ray, sphere, nodes, generator) } -> std::same_as<float>;
+    { tracer.shade(ray, sphere, 0.0f, nodes, generator) } -> std::same_as<sf::Vector3f>;
+};
+
+} // namespace
+
 Context::Context(const sf::Vector2u& dimensions, float vertical_fov) :
     image_size_{dimensions}, aspect_ratio_{static_cast<float>(image_size_.x) / static_cast<float>(image_size_.y)},
-    vertical_fov_{vertical_fov}, tan_fvov_{std::tan(glm::radians(vertical_fov_ / 2.0f))}
+    vertical_fov_{vertical_fov}, tan_fvov_{std::tan(glm::radians(vertical_fov_ / 2.0f))},
+    framebuffer_{image_size_}, tiles_{tiles::spiral_tiles(image_size_)}
+{
+}
+
+template <typename TracePixel>
+void Context::trace_samples(const TracePixel& trace_pixel, std::uint32_t x, std::uint32_t y, std::uint32_t count,
+                            std::uint64_t seed, bool jitter, std::uint32_t stride, const tiles::Tile& tile)
+{
+    [[maybe_unused]] std::chrono::steady_clock::time_point start;
+    if constexpr (stats::enabled)
+    {
+        // Drop events counted outside pixels, such as in the tracer's prepare
+        stats::take_thread_counters();
+        start = std::chrono::steady_clock::now();
+    }
+
+    randomgen::Generator generator{y * image_size_.x + x, seed};
+    sf::Vector3f color_sum{};
+    float luminance_squares{0.0f};
+    for (std::uint32_t sample = 0; sample < count; ++sample)
+    {
+        const float offset_x{jitter ? generator.random_float() : 0.5f};
+        const float offset_y{jitter ? generator.random_float() : 0.5f};
+        const sf::Vector3f color{trace_pixel(x + offset_x, y + offset_y, generator)};
+        color_sum += color;
+        luminance_squares += luminance(color) * luminance(color);
+    }
+
+    for (std::uint32_t block_y = y; block_y < std::min(y + stride, tile.y1); ++block_y)
+    {
+        for (std::uint32_t block_x = x; block_x < std::min(x + stride, tile.x1); ++block_x)
+        {
+            framebuffer_.add_samples(block_x, block_y, color_sum, luminance_squares, count);
+        }
+    }
+
+    if constexpr (stats::enabled)
+    {
+        const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() - start};
+        record_pixel_stats(x, y, count, elapsed.count(), stride, tile);
+    }
+}
+
+template <typename TracePixel>
+bool Context::render_tiles(const TracePixel& trace_pixel, std::stop_token stop)
+{
+    const std::uint32_t stride{pixel_stride_};
+    if (adaptive_sampling_.enabled && stride == 1)
+    {
+        return render_adaptive(trace_pixel, stop);
+    }
+    const auto start{std::chrono::steady_clock::now()};
+    begin_stats();
+    const bool jitter{!centred_pass()};
+    if (!accumulate_ || stride > 1 || preview_in_framebuffer_)
+    {
+        reset_accumulation();
+    }
+    image_stale_ = true;
+
+    // Every accumulated pass draws from new random streams; the first stays reproducible per frame
+    const std::uint64_t seed{frame_ | (std::uint64_t{accumulated_samples_} << 32)};
+    std::atomic<std::uint64_t> rendered_samples{0};
+    const bool completed{scheduler_.run(
+        tiles_,
+        [&](const tiles::Tile& tile, std::size_t /*tile_index*/, std::stop_token tile_stop)
+        {
+            std::uint64_t tile_samples{0};
+            for (std::uint32_t y = tile.y0; y < tile.y1 && !tile_stop.stop_requested(); y += stride)
+            {
+                for (std::uint32_t x = tile.x0; x < tile.x1; x += stride)
+                {
+                    trace_samples(trace_pixel, x, y, samples_per_pixel_, seed, jitter, stride, tile);
+                    tile_samples += samples_per_pixel_;
+                }
+            }
+            rendered_samples.fetch_add(tile_samples, std::memory_order_relaxed);
+        },
+        stop, tile_done_)};
+
+    rendered_samples_ = rendered_samples.load();
+    end_stats(std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count());
+    preview_in_framebuffer_ = stride > 1;
+    if (completed && stride == 1)
+    {
+        accumulated_samples_ += samples_per_pixel_;
+    }
+    return completed;
+}
+
+template <typename TracePixel>
+bool Context::render_adaptive(const TracePixel& trace_pixel, std::stop_token stop)
+{
+    const AdaptiveSampling& settings{adaptive_sampling_};
+    const auto start{std::chrono::steady_clock::now()};
+    begin_stats();
+    reset_accumulation();
+
+    // Tiles holding a pixel that may still take samples; a pass only visits these. Late passes are left with
+    // few unconverged tiles, so tiles are smaller than for uniform renders to keep every thread busy.
+    std::vector<tiles::Tile> active_tiles{tiles::spiral_tiles(image_size_, adaptive_tile_size)};
+    std::vector<char> tile_active(active_tiles.size());
+    std::atomic<std::uint64_t> rendered_samples{0};
+    bool completed{true};
+    while (!active_tiles.empty())
+    {
+        completed = scheduler_.run(
+            active_tiles,
+            [&](const tiles::Tile& tile, std::size_t tile_index, std::stop_token tile_stop)
+            {
+                std::uint64_t tile_samples{0};
+                bool active{false};
+                for (std::uint32_t y = tile.y0; y < tile.y1 && !tile_stop.stop_requested(); ++y)
+                {
+                    for (std::uint32_t x = tile.x0; x < tile.x1; ++x)
+                    {
+                        const auto taken{static_cast<std::uint32_t>(framebuffer_.pixel(x, y).count)};
+                        if (taken >= settings.max_samples || (taken >= settings.min_samples && converged(x, y)))
+                        {
+                            continue;
+                        }
+
+                        // Each sample index has its own random stream, so passes never repeat samples
+                        const std::uint32_t count{
+                            std::min(taken < settings.min_samples ? settings.min_samples - taken
+                                                                  : settings.batch_samples,
+                                     settings.max_samples - taken)};
+                        trace_samples(trace_pixel, x, y, count, frame_ | (std::uint64_t{taken} << 32), true, 1,
+                                      tile);
+                        tile_samples += count;
+                        active = active || (taken + count < settings.max_samples && !converged(x, y));
+                    }
+                }
+                tile_active[tile_index] = active;
+                rendered_samples.fetch_add(tile_samples, std::memory_order_relaxed);
+            },
+            stop, tile_done_);
+        if (!completed)
+        {
+            break;
+        }
+
+        const std::chrono::duration<float> elapsed{std::chrono::steady_clock::now() - start};
+        if ((settings.sample_budget > 0 && rendered_samples.load() >= settings.sample_budget) ||
+            (settings.time_budget > 0.0f && elapsed.count() >= settings.time_budget))
+        {
+            break;
+        }
+
+        std::size_t kept{0};
+        for (std::size_t tile = 0; tile < active_tiles.size(); ++tile)
+        {
+            if (tile_active[tile])
+            {
+                active_tiles[kept++] = active_tiles[tile];
+            }
+        }
+        active_tiles.resize(kept);
+    }
+
+    rendered_samples_ = rendered_samples.load();
+    end_stats(std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count());
+    return completed;
+}
+
+void Context::begin_stats()
+{
+    if constexpr (stats::enabled)
+    {
+        const std::size_t pixels{static_cast<std::size_t>(image_size_.x) * image_size_.y};
+        thread_loads_.assign(static_cast<std::size_t>(stats::max_threads()), stats::ThreadLoad{});
+        pixel_seconds_.assign(pixels, 0.0f);
+        pixel_events_.assign(pixels, 0.0f);
+    }
+}
+
+void Context::record_pixel_stats(std::uint32_t x, std::uint32_t y, std::uint32_t count, double seconds,
+                                 std::uint32_t stride, const tiles::Tile& tile)
+{
+    const stats::Counters counters{stats::take_thread_counters()};
+    const auto thread{static_cast<std::size_t>(stats::thread_index())};
+    if (thread < thread_loads_.size())
+    {
+        // Only this thread writes its load
+        stats::ThreadLoad& load{thread_loads_[thread]};
+        ++load.pixels;
+        load.samples += count;
+        load.busy_seconds += seconds;
+        load.counters += counters;
+    }
+
+    const auto events{static_cast<float>(counters.events())};
+    for (std::uint32_t block_y = y; block_y < std::min(y + stride, tile.y1); ++block_y)
+    {
+        for (std::uint32_t block_x = x; block_x < std::min(x + stride, tile.x1); ++block_x)
+        {
+            const std::size_t pixel{static_cast<std::size_t>(block_y) * image_size_.x + block_x};
+            pixel_seconds_[pixel] += static_cast<float>(seconds);
+            pixel_events_[pixel] += events;
+        }
+    }
+}
+
+void Context::end_stats(double seconds)
+{
+    if constexpr (stats::enabled)
+    {
+        frame_stats_ = stats::FrameStats{};
+        frame_stats_.seconds = seconds;
+        for (const stats::ThreadLoad& load : thread_loads_)
+        {
+            if (load.pixels == 0)
+            {
+                continue;
+            }
+            frame_stats_.totals += load.counters;
+            frame_stats_.pixels += load.pixels;
+            frame_stats_.samples += load.samples;
+            frame_stats_.threads.push_back(load);
+        }
+    }
+}
+
+const stats::FrameStats& Context::frame_stats() const
+{
+    return frame_stats_;
+}
+
+sf::Image Context::cost_heatmap(stats::HeatmapMetric metric, std::uint8_t alpha) const
+{
+    const std::size_t pixels{static_cast<std::size_t>(image_size_.x) * image_size_.y};
+    const std::vector<float>& costs{metric == stats::HeatmapMetric::Time ? pixel_seconds_ : pixel_events_};
+    return stats::heatmap_image(costs.size() == pixels ? costs : std::vector<float>(pixels, 0.0f), image_size_,
+                                alpha);
+}
+
+bool Context::centred_pass() const
 {
-    image_.create(image_size_.x, image_size_.y, sf::Color::Black);
-    load_image();
-    sprite_.setTexture(texture_, true);
+    if (adaptive_sampling_.enabled && pixel_stride_ == 1)
+    {
+        return false;
+    }
+    // Passes that start over trace the pixel centres when they take a single sample, like the first pass does
+    const bool restarts{!accumulate_ || pixel_stride_ > 1 || preview_in_framebuffer_};
+    return samples_per_pixel_ == 1 && (restarts || accumulated_samples_ == 0);
 }
 
-void Context::render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere,
-                           const scene::SceneTracer& trace_scene)
+bool Context::prepare_geometry_cache(const glm::vec3& ray_origin, const scene::GeometryKey& key)
 {
-    const std::uint32_t dimensions{image_size_.x * image_size_.y};
-#pragma omp parallel for schedule(dynamic)
-    for (std::uint32_t index = 0; index < dimensions; ++index)
+    const std::size_t pixels{static_cast<std::size_t>(image_size_.x) * image_size_.y};
+    if (pixels * static_cast<std::size_t>(key.nodes) > max_cached_nodes)
     {
-        const std::uint32_t y{index / image_size_.x};
-        const std::uint32_t x{index % image_size_.x};
-        glm::vec3 pixel_screen_coordinates{((2.0f * ((x + 0.5f) / image_size_.x)) - 1.0f) * aspect_ratio_ * tan_fvov_,
-                                           (-1 * ((2.0f * ((y + 0.5f) / image_size_.y)) - 1.0f)) * tan_fvov_, -1.0f};
+        return false;
+    }
+    // Centred passes draw from the pixel streams of the frame, which jittered geometry depends on
+    if (geometry_cache_.filled.size() == pixels && geometry_cache_.ray_origin == ray_origin &&
+        geometry_cache_.frame == frame_ && geometry_cache_.key == key)
+    {
+        return true;
+    }
 
-        geometry::Ray ray{.origin = ray_origin, .direction = glm::normalize(pixel_screen_coordinates - ray_origin)};
-        image_.setPixel(x, y, util::vector_to_color(trace_scene(ray, sphere)));
+    geometry_cache_.ray_origin = ray_origin;
+    geometry_cache_.frame = frame_;
+    geometry_cache_.key = key;
+    geometry_cache_.lengths.assign(pixels, 0.0f);
+    geometry_cache_.nodes.assign(pixels * static_cast<std::size_t>(key.nodes), 0.0f);
+    geometry_cache_.filled.assign(pixels, 0);
+    return true;
+}
+
+template <typename Tracer>
+bool Context::render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere, Tracer& trace_scene,
+                           std::stop_token stop)
+{
+    trace_scene.prepare(sphere);
+    const auto camera_ray = [&](float x, float y)
+    {
+        return geometry::Ray{.origin = ray_origin,
+                             .direction = glm::normalize(pixel_screen_coordinates(x, y) - ray_origin)};
+    };
+    bool completed{false};
+    bool cached{false};
+    if constexpr (CachesGeometry<Tracer>)
+    {
+        cached = geometry_caching_ && centred_pass() &&
+                 prepare_geometry_cache(ray_origin, trace_scene.geometry_key(sphere));
+        if (cached)
+        {
+            const std::size_t pixel_nodes{static_cast<std::size_t>(geometry_cache_.key.nodes)};
+            completed = render_tiles(
+                [&](float x, float y, randomgen::Generator& generator)
+                {
+                    const geometry::Ray ray{camera_ray(x, y)};
+                    const std::size_t pixel{static_cast<std::size_t>(y) * image_size_.x +
+                                            static_cast<std::size_t>(x)};
+                    float* nodes{geometry_cache_.nodes.data() + pixel * pixel_nodes};
+                    // Forked for cached pixels too, so shade draws the same numbers as when tracing
+                    randomgen::Generator geometry_generator{generator.fork()};
+                    if (!geometry_cache_.filled[pixel])
+                    {
+                        geometry_cache_.lengths[pixel] =
+                            trace_scene.ray_geometry(ray, sphere, nodes, geometry_generator);
+                        geometry_cache_.filled[pixel] = 1;
+                    }
+                    return trace_scene.shade(ray, sphere, geometry_cache_.lengths[pixel], nodes, generator);
+                },
+                stop);
+        }
+    }
+    if (!cached)
+    {
+        completed = render_tiles(
+            [&](float x, float y, randomgen::Generator& generator)
+            {
+                return trace_scene(camera_ray(x, y), sphere, generator);
+            },
+            stop);
     }
 
-    load_image();
-    image_.saveToFile("volume.png");
+    if (completed)
+    {
+        write_output("volume.png");
+    }
+    return completed;
 }
 
-void Context::render_image(const glm::vec3& ray_origin, const primitives::Box& box,
-                           const scene::SceneTracer& trace_scene)
+template <typename Tracer>
+bool Context::render_image(const glm::vec3& ray_origin, const primitives::Box& box, Tracer& trace_scene,
+                           std::stop_token stop)
 {
     glm::mat4 camera_to_world{glm::translate(glm::mat4{1.0f}, glm::vec3{83.292171f, 25.137326f, 126.430772f})};
     camera_to_world = glm::rotate(camera_to_world, glm::radians(30.0f), glm::vec3{0.0f, 1.0f, 0.0f});
     camera_to_world = glm::rotate(camera_to_world, glm::radians(-15.0f), glm::vec3{1.0f, 0.0f, 0.0f});
+    trace_scene.prepare(box);
+
+    const bool completed{render_tiles(
+        [&](float x, float y, randomgen::Generator& generator)
+        {
+            auto ray = util::transform_ray(camera_to_world, ray_origin, pixel_screen_coordinates(x, y));
+            ray.compute_inv_direction();
+            return trace_scene(ray, box, generator);
+        },
+        stop)};
 
-    const std::uint32_t dimensions{image_size_.x * image_size_.y};
-#pragma omp parallel for schedule(dynamic)
-    for (std::uint32_t index = 0; index < dimensions; ++index)
+    if (completed)
     {
-        const std::uint32_t y{index / image_size_.x};
-        const std::uint32_t x{index % image_size_.x};
-        glm::vec3 pixel_screen_coordinates{((2.0f * ((x + 0.5f) / image_size_.x)) - 1.0f) * aspect_ratio_ * tan_fvov_,
-                                           (-1 * ((2.0f * ((y + 0.5f) / image_size_.y)) - 1.0f)) * tan_fvov_, -1.0f};
-        auto ray = util::transform_ray(camera_to_world, ray_origin, pixel_screen_coordinates);
-        ray.compute_inv_direction();
-        image_.setPixel(x, y, util::vector_to_color(trace_scene(ray, box)));
+        write_output("grid_volume.png");
     }
+    return completed;
+}
+
+bool Context::render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere,
+                           scene::Tracer& trace_scene, std::stop_token stop)
+{
+    return std::visit([&](auto& tracer) { return render_image(ray_origin, sphere, tracer, stop); }, trace_scene);
+}
 
-    load_image();
-    image_.saveToFile("grid_volume.png");
+bool Context::render_image(const glm::vec3& ray_origin, const primitives::Box& box, scene::Tracer& trace_scene,
+                           std::stop_token stop)
+{
+    return std::visit([&](auto& tracer) { return render_image(ray_origin, box, tracer, stop); }, trace_scene);
 }
 
-void Context::set_color(const sf::Color& color)
+// The render templates for the virtual interface and for every chapter tracer
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::SceneTracer&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::SceneTracer&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::VolumeAbsorption&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::VolumeAbsorption&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::VolumeInScattering&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::VolumeInScattering&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::VolumeComplete&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::VolumeComplete&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&,
+                                    scene::BasicVolumeDensityField<scene::DefaultPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&,
+                                    scene::BasicVolumeDensityField<scene::DefaultPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&,
+                                    scene::BasicVolumeDensityField<scene::DeterministicPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&,
+                                    scene::BasicVolumeDensityField<scene::DeterministicPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&,
+                                    scene::BasicVolumeVoxelGrid<scene::DefaultPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&,
+                                    scene::BasicVolumeVoxelGrid<scene::DefaultPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&,
+                                    scene::BasicVolumeVoxelGrid<scene::DeterministicPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&,
+                                    scene::BasicVolumeVoxelGrid<scene::DeterministicPolicy>&, std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::VolumeDeltaTracking&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::VolumeDeltaTracking&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Sphere&, scene::VolumeSingleScattering&,
+                                    std::stop_token);
+template bool Context::render_image(const glm::vec3&, const primitives::Box&, scene::VolumeSingleScattering&,
+                                    std::stop_token);
+
+void Context::set_geometry_caching(bool enabled)
 {
-    for (std::uint32_t y = 0; y < image_size_.y; ++y)
+    geometry_caching_ = enabled;
+    if (!enabled)
     {
-        for (std::uint32_t x = 0; x < image_size_.x; ++x)
-        {
-            image_.setPixel(x, y, color);
-        }
+        geometry_cache_ = GeometryCache{};
     }
-    load_image();
 }
 
-void Context::set_color(const sf::Vector3f& color)
+void Context::set_frame(std::uint32_t frame)
+{
+    frame_ = frame;
+}
+
+void Context::set_samples_per_pixel(std::uint32_t samples)
+{
+    samples_per_pixel_ = std::max<std::uint32_t>(samples, 1);
+}
+
+void Context::set_accumulate(bool accumulate)
+{
+    accumulate_ = accumulate;
+}
+
+void Context::reset_accumulation()
+{
+    accumulated_samples_ = 0;
+    preview_in_framebuffer_ = false;
+    framebuffer_.clear();
+    image_stale_ = true;
+}
+
+void Context::set_adaptive_sampling(const AdaptiveSampling& settings)
 {
-    set_color(util::vector_to_color(color));
+    adaptive_sampling_ = settings;
+    adaptive_sampling_.min_samples = std::max<std::uint32_t>(settings.min_samples, 2);
+    adaptive_sampling_.max_samples = std::max(settings.max_samples, adaptive_sampling_.min_samples);
+    adaptive_sampling_.batch_samples = std::max<std::uint32_t>(settings.batch_samples, 1);
 }
 
-void Context::draw(sf::RenderWindow& window)
+std::uint64_t Context::rendered_samples() const
 {
-    window.draw(sprite_);
+    return rendered_samples_;
 }
 
-void Context::load_image()
+std::uint32_t Context::accumulated_samples() const
 {
-    if (!texture_.loadFromImage(image_))
+    return accumulated_samples_;
+}
+
+void Context::set_pixel_stride(std::uint32_t stride)
+{
+    pixel_stride_ = std::max<std::uint32_t>(stride, 1);
+}
+
+void Context::set_output(output::OutputSettings settings)
+{
+    output_settings_ = std::move(settings);
+}
+
+void Context::flush_output()
+{
+    output_queue_.flush();
+}
+
+void Context::set_tile_callback(tiles::TileScheduler::TileDone tile_done)
+{
+    tile_done_ = std::move(tile_done);
+}
+
+void Context::set_tone_mapping(ToneMapping tone_mapping, float exposure)
+{
+    tone_mapping_ = tone_mapping;
+    exposure_ = exposure;
+    image_stale_ = true;
+}
+
+const FrameBuffer& Context::framebuffer() const
+{
+    return framebuffer_;
+}
+
+const sf::Image& Context::image() const
+{
+    if (image_stale_)
+    {
+        framebuffer_.resolve(image_, tone_mapping_, exposure_);
+        image_stale_ = false;
+    }
+    return image_;
+}
+
+void Context::set_color(const sf::Color& color)
+{
+    set_color(sf::Vector3f{color.r / 255.0f, color.g / 255.0f, color.b / 255.0f});
+}
+
+void Context::set_color(const sf::Vector3f& color)
+{
+    framebuffer_.fill(color);
+    image_stale_ = true;
+}
+
+void Context::write_output(const std::string& default_path)
+{
+    if (output_settings_.enabled)
     {
-        throw std::runtime_error{"Failed to load image to texture"};
+        output_queue_.enqueue(framebuffer_, output_settings_,
+                              output_settings_.path.empty() ? default_path : output_settings_.path);
     }
 }
 
-} // namespace render
\ No newline at end of file
+bool Context::converged(std::uint32_t x, std::uint32_t y) const
+{
+    const float mean_luminance{luminance(framebuffer_.mean(x, y))};
+    const float tolerance{adaptive_sampling_.relative_error * std::max(mean_luminance, 0.01f)};
+    return framebuffer_.mean_variance(x, y) <= tolerance * tolerance;
+}
+
+glm::vec3 Context::pixel_screen_coordinates(float x, float y) const
+{
+    return glm::vec3{((2.0f * (x / image_size_.x)) - 1.0f) * aspect_ratio_ * tan_fvov_,
+                     (-1 * ((2.0f * (y / image_size_.y)) - 1.0f)) * tan_fvov_, -1.0f};
+}
+
+} // namespace render
@@ -1,57 +1,184 @@
 #ifndef CONTEXT_HPP
 #define CONTEXT_HPP
 
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+
 #include <SFML/Graphics/Image.hpp>
-#include <SFML/Graphics/RenderWindow.hpp>
-#include <SFML/Graphics/Sprite.hpp>
-#include <SFML/Graphics/Texture.hpp>
+#include <SFML/System/Vector2.hpp>
 #include <SFML/System/Vector3.hpp>
 #include <glm/glm.hpp>
 
+#include "framebuffer.hpp"
+#include "output.hpp"
+#include "scene_tracer.hpp"
+#include "stats.hpp"
+#include "tiles.hpp"
+
 // Forward declarations
 namespace primitives
 {
 
-class Sphere;
-class Box;
+struct Sphere;
+struct Box;
 
 } // namespace primitives
 
-namespace scene
+namespace render
 {
 
-class SceneTracer;
+/*
 
-} // namespace scene
+Renders a scene into an in-memory image. Context has no window or GPU dependency;
+see display.hpp to show its image in a window.
 
-namespace render
+Samples accumulate in a float framebuffer; image() tone maps it to 8 bits on demand.
+Renders that trace the pixel centres once (a first pass of one sample per pixel, or its strided
+preview) keep the geometry of those rays for tracers that can shade it again (see scene::GeometryKey),
+so edits of coefficients, colours or phase parameters skip the intersections and light paths.
+Pixels are rendered in 16x16 tiles spiralling out from the image centre (see tiles.hpp).
+A render can be cancelled through its stop token, in which case it returns false and
+pixels it did not reach hold fewer samples; accumulated samples should then be reset.
+
+*/
+
+// Variance-driven sampling: after min_samples everywhere, passes of batch_samples go only to pixels whose
+// estimate has not converged, until every pixel converged or reached max_samples, or a budget ran out
+struct AdaptiveSampling
 {
+    bool enabled{false};
+    std::uint32_t min_samples{8};
+    std::uint32_t max_samples{256};
+    std::uint32_t batch_samples{8};
+    // Converged once the standard error of the mean luminance is below this fraction of the mean
+    // (of at least 0.01, so dark pixels need not resolve noise nobody can see)
+    float relative_error{0.02f};
+    // Total samples and seconds of a render, zero for no limit; checked between passes
+    std::uint64_t sample_budget{0};
+    float time_budget{0.0f};
+};
 
 class Context
 {
 public:
     Context(const sf::Vector2u& dimensions, float vertical_fov = 45.0f);
 
-    void render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere,
-                      const scene::SceneTracer& trace_scene);
-    void render_image(const glm::vec3& ray_origin, const primitives::Box& box, const scene::SceneTracer& trace_scene);
+    // Tracer is scene::SceneTracer, called through its virtual interface for every sample, or one of the chapter
+    // tracers, whose calls are resolved at compile time; context.cpp instantiates both kinds
+    template <typename Tracer>
+    bool render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere, Tracer& trace_scene,
+                      std::stop_token stop = {});
+    template <typename Tracer>
+    bool render_image(const glm::vec3& ray_origin, const primitives::Box& box, Tracer& trace_scene,
+                      std::stop_token stop = {});
+    // Dispatches once per frame to the chapter tracer the variant holds
+    bool render_image(const glm::vec3& ray_origin, const primitives::Sphere& sphere, scene::Tracer& trace_scene,
+                      std::stop_token stop = {});
+    bool render_image(const glm::vec3& ray_origin, const primitives::Box& box, scene::Tracer& trace_scene,
+                      std::stop_token stop = {});
 
+    // Selects the random streams used by the next render; images are reproducible per frame
+    void set_frame(std::uint32_t frame);
+    // Samples averaged per pixel; with more than one, samples are jittered inside the pixel
+    void set_samples_per_pixel(std::uint32_t samples);
+    // When on, each render adds its samples to those of previous renders instead of replacing them
+    void set_accumulate(bool accumulate);
+    // Adaptive renders replace set_samples_per_pixel and always start from an empty framebuffer
+    void set_adaptive_sampling(const AdaptiveSampling& settings);
+    // Samples traced by the last render, over all pixels
+    std::uint64_t rendered_samples() const;
+    // Discards the accumulated samples; the next render starts from scratch
+    void reset_accumulation();
+    std::uint32_t accumulated_samples() const;
+    // Renders one pixel per stride x stride block and fills the block with it; strides above 1
+    // give fast previews, which are discarded by the next full resolution render
+    void set_pixel_stride(std::uint32_t stride);
+    // Keeps the pixel-centre ray geometry between renders (on by default); when off, every render traces in full
+    void set_geometry_caching(bool enabled);
+    // Where and whether completed renders are written; writing happens on a background thread
+    void set_output(output::OutputSettings settings);
+    // Blocks until every completed render has been written; throws if writing one failed
+    void flush_output();
+    // Called from the render threads as each tile of the image completes
+    void set_tile_callback(tiles::TileScheduler::TileDone tile_done);
+    void set_tone_mapping(ToneMapping tone_mapping, float exposure = 1.0f);
+    const FrameBuffer& framebuffer() const;
+    // Resolves the framebuffer if it changed since the last call
+    const sf::Image& image() const;
+    // Statistics of the last render, counted only in builds with VOLRENDER_STATS (see stats.hpp)
+    const stats::FrameStats& frame_stats() const;
+    // Per-pixel cost of the last render; black unless built with VOLRENDER_STATS
+    sf::Image cost_heatmap(stats::HeatmapMetric metric, std::uint8_t alpha = 255) const;
     void set_color(const sf::Color& color);
     void set_color(const sf::Vector3f& color);
-    void draw(sf::RenderWindow& window);
 
 private:
     const sf::Vector2u image_size_;
     const float aspect_ratio_;
     const float vertical_fov_;
     const float tan_fvov_;
-    sf::Image image_{};
-    sf::Texture texture_{};
-    sf::Sprite sprite_{};
+    std::uint32_t frame_{0};
+    std::uint32_t samples_per_pixel_{1};
+    std::uint32_t pixel_stride_{1};
+    bool accumulate_{false};
+    bool preview_in_framebuffer_{false};
+    std::uint32_t accumulated_samples_{0};
+    AdaptiveSampling adaptive_sampling_{};
+    std::uint64_t rendered_samples_{0};
+    ToneMapping tone_mapping_{ToneMapping::Clamp};
+    float exposure_{1.0f};
+    FrameBuffer framebuffer_;
+    mutable sf::Image image_{};
+    mutable bool image_stale_{true};
+    output::OutputSettings output_settings_{};
+    // Geometry of the pixel-centre rays: per pixel a length and key.nodes floats, filled as pixels are traced
+    struct GeometryCache
+    {
+        glm::vec3 ray_origin{};
+        std::uint32_t frame{0};
+        scene::GeometryKey key{};
+        std::vector<float> lengths;
+        std::vector<float> nodes;
+        std::vector<std::uint8_t> filled;
+    };
+    GeometryCache geometry_cache_{};
+    bool geometry_caching_{true};
+    // Collected while rendering when stats::enabled: one load per render thread, cost per pixel
+    std::vector<stats::ThreadLoad> thread_loads_;
+    std::vector<float> pixel_seconds_;
+    std::vector<float> pixel_events_;
+    stats::FrameStats frame_stats_{};
+    const std::vector<tiles::Tile> tiles_;
+    tiles::TileScheduler scheduler_{};
+    tiles::TileScheduler::TileDone tile_done_{};
+    // Declared last so pending images are written before the rest of the context goes away
+    output::OutputQueue output_queue_{};
 
-    void load_image();
+    glm::vec3 pixel_screen_coordinates(float x, float y) const;
+    // trace_pixel(x, y, generator) returns the colour of one sample at pixel coordinates (x, y)
+    template <typename TracePixel>
+    bool render_tiles(const TracePixel& trace_pixel, std::stop_token stop);
+    template <typename TracePixel>
+    bool render_adaptive(const TracePixel& trace_pixel, std::stop_token stop);
+    // Traces count samples of pixel (x, y) from the random stream seed and adds them to the framebuffer
+    template <typename TracePixel>
+    void trace_samples(const TracePixel& trace_pixel, std::uint32_t x, std::uint32_t y, std::uint32_t count,
+                       std::uint64_t seed, bool jitter, std::uint32_t stride, const tiles::Tile& tile);
+    bool converged(std::uint32_t x, std::uint32_t y) const;
+    void begin_stats();
+    // Adds the events the calling thread counted for pixel (x, y) and its stride block
+    void record_pixel_stats(std::uint32_t x, std::uint32_t y, std::uint32_t count, double seconds, std::uint32_t stride,
+                            const tiles::Tile& tile);
+    void end_stats(double seconds);
+    // Whether the next render_tiles pass traces exactly one sample at each pixel centre
+    bool centred_pass() const;
+    // Keeps the cached geometry if it was made for the same camera and key, otherwise empties it;
+    // returns false if the geometry is too large to cache
+    bool prepare_geometry_cache(const glm::vec3& ray_origin, const scene::GeometryKey& key);
+    void write_output(const std::string& default_path);
 };
 
 } // namespace render
 
-#endif // CONTEXT_HPP
\ No newline at end of file
+#endif // CONTEXT_HPP
@@ -1,45 +1,73 @@
 #include <algorithm>
 
-#include <noise/noise.h>
-
 #include "density.hpp"
 #include "primitives.hpp"
+#include "sampler.hpp"
+#include "stats.hpp"
 
 namespace density
 {
 
-float eval_fbm(const glm::vec3& position, const glm::vec3& center, float radius)
+namespace
+{
+
+float fbm_falloff(const glm::vec3& relative_position, float radius)
+{
+    const float distance{std::min(1.0f, relative_position.length() / radius)};
+    return glm::smoothstep(0.8f, 1.0f, distance);
+}
+
+} // namespace
+
+float eval_fbm(const glm::vec3& position, const glm::vec3& center, float radius, const perlin::Fbm& noise)
 {
-    static noise::module::Perlin fbm;
-    fbm.SetFrequency(0.5);
-    fbm.SetOctaveCount(6);
-    fbm.SetLacunarity(2.0);
-    glm::vec3 relative_position = position - center;
+    stats::count(stats::Counter::FbmEvaluations);
+    const glm::vec3 relative_position{position - center};
+    return std::max(0.0f, noise(relative_position)) * (1.0f - fbm_falloff(relative_position, radius));
+}
 
-    float distance = std::min(1.0f, relative_position.length() / radius);
-    float falloff = glm::smoothstep(0.8f, 1.0f, distance);
+void eval_fbm(const float* x, const float* y, const float* z, float* densities, int count, const glm::vec3& center,
+              float radius, const perlin::Fbm& noise)
+{
+    stats::count(stats::Counter::FbmEvaluations, static_cast<std::uint64_t>(count));
+    constexpr int lanes{perlin::Fbm::lanes};
+    for (int first = 0; first < count; first += lanes)
+    {
+        const int size{std::min(lanes, count - first)};
+        alignas(32) float relative_x[lanes];
+        alignas(32) float relative_y[lanes];
+        alignas(32) float relative_z[lanes];
+        for (int lane = 0; lane < size; ++lane)
+        {
+            relative_x[lane] = x[first + lane] - center.x;
+            relative_y[lane] = y[first + lane] - center.y;
+            relative_z[lane] = z[first + lane] - center.z;
+        }
 
-    float fbm_result = static_cast<float>(fbm.GetValue(relative_position.x, relative_position.y, relative_position.z));
-    return std::max(0.0f, fbm_result) * (1.0 - falloff);
+        noise.evaluate(relative_x, relative_y, relative_z, densities + first, size);
+        for (int lane = 0; lane < size; ++lane)
+        {
+            const glm::vec3 relative_position{relative_x[lane], relative_y[lane], relative_z[lane]};
+            densities[first + lane] =
+                std::max(0.0f, densities[first + lane]) * (1.0f - fbm_falloff(relative_position, radius));
+        }
+    }
 }
 
 float eval_grid(const glm::vec3& position, const primitives::Box& grid)
 {
+    stats::count(stats::Counter::GridLookups);
     const glm::vec3 grid_size{grid.bounds[1] - grid.bounds[0]};
     const glm::vec3 object_space_point{(position - grid.bounds[0]) / grid_size};
     const glm::vec3 voxel_space_point{static_cast<float>(grid.grid_resolution) * object_space_point};
     const glm::vec3 voxel_lattice{voxel_space_point - 0.5f};
-    const int x{static_cast<int>(std::floor(voxel_lattice.x))};
-    const int y{static_cast<int>(std::floor(voxel_lattice.y))};
-    const int z{static_cast<int>(std::floor(voxel_lattice.z))};
-
-    if (x < 0 || x >= grid.grid_resolution || y < 0 || y >= grid.grid_resolution || z < 0 || z >= grid.grid_resolution)
-    {
-        return 0.0f;
-    }
+    return sampler::sample(grid.density, voxel_lattice, grid.filter());
+}
 
-    return grid.density[(z * grid.grid_resolution + y) * grid.grid_resolution + x];
-    // return 1.0f;
+float eval_voxel(const glm::ivec3& voxel, const primitives::Box& grid)
+{
+    stats::count(stats::Counter::GridLookups);
+    return grid.density.value(voxel);
 }
 
 } // namespace density
\ No newline at end of file
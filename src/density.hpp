@@ -3,6 +3,8 @@
 
 #include <glm/glm.hpp>
 
+#include "perlin.hpp"
+
 // Forward declaration
 namespace primitives
 {
@@ -14,8 +16,15 @@ struct Box;
 namespace density
 {
 
-float eval_fbm(const glm::vec3& position, const glm::vec3& center, float radius);
+// Noise sphere: fBm around center, clamped to positive values
+float eval_fbm(const glm::vec3& position, const glm::vec3& center, float radius, const perlin::Fbm& noise);
+// eval_fbm at count positions given as coordinate arrays
+void eval_fbm(const float* x, const float* y, const float* z, float* densities, int count, const glm::vec3& center,
+              float radius, const perlin::Fbm& noise);
+// Density at a world position, reconstructed with the filter of the grid
 float eval_grid(const glm::vec3& position, const primitives::Box& grid);
+// Density of a single cell of the grid lattice; zero outside of the grid
+float eval_voxel(const glm::ivec3& voxel, const primitives::Box& grid);
 
 } // namespace density
 
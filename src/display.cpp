@@ -0,0 +1,45 @@
+#include <stdexcept>
+
+#include "display.hpp"
+
+namespace render
+{
+
+Display::Display(const sf::Image& image)
+{
+    update(image);
+    sprite_.setTexture(texture_, true);
+}
+
+void Display::update(const sf::Image& image)
+{
+    if (!texture_.loadFromImage(image))
+    {
+        throw std::runtime_error{"Failed to load image to texture"};
+    }
+}
+
+void Display::update_overlay(const sf::Image& image)
+{
+    if (!overlay_texture_.loadFromImage(image))
+    {
+        throw std::runtime_error{"Failed to load overlay to texture"};
+    }
+    overlay_sprite_.setTexture(overlay_texture_, true);
+}
+
+void Display::set_overlay_visible(bool visible)
+{
+    overlay_visible_ = visible;
+}
+
+void Display::draw(sf::RenderWindow& window)
+{
+    window.draw(sprite_);
+    if (overlay_visible_ && overlay_texture_.getSize().x > 0)
+    {
+        window.draw(overlay_sprite_);
+    }
+}
+
+} // namespace render
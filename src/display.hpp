@@ -0,0 +1,35 @@
+#ifndef DISPLAY_HPP
+#define DISPLAY_HPP
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/RenderWindow.hpp>
+#include <SFML/Graphics/Sprite.hpp>
+#include <SFML/Graphics/Texture.hpp>
+
+namespace render
+{
+
+// Shows a rendered image in a window; the only part of the renderer that needs a GPU context
+class Display
+{
+public:
+    explicit Display(const sf::Image& image);
+
+    // Uploads the image to the texture drawn by draw
+    void update(const sf::Image& image);
+    // Uploads an image drawn over the render while the overlay is visible, e.g. a cost heatmap
+    void update_overlay(const sf::Image& image);
+    void set_overlay_visible(bool visible);
+    void draw(sf::RenderWindow& window);
+
+private:
+    sf::Texture texture_{};
+    sf::Sprite sprite_{};
+    sf::Texture overlay_texture_{};
+    sf::Sprite overlay_sprite_{};
+    bool overlay_visible_{false};
+};
+
+} // namespace render
+
+#endif // DISPLAY_HPP
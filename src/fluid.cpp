@@ -1,10 +1,14 @@
 #include <algorithm>
 #include <array>
+#include <charconv>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/string_cast.hpp>
@@ -17,35 +21,115 @@
 #include <SFML/Window/Event.hpp>
 
 #include "context.hpp"
+#include "display.hpp"
 #include "primitives.hpp"
 #include "ray.hpp"
 #include "scene_tracer.hpp"
+#include "sequence.hpp"
+#include "stats.hpp"
 
-std::vector<float> read_density_from_file(std::string filename = "cachefiles/grid.40.bin")
+// Renders frames [first_frame, last_frame] of a simulation; grids are prefetched and images written
+// on background threads, so disk I/O overlaps with rendering
+int render_sequence(const std::string& grid_pattern, int first_frame, int last_frame, std::size_t prefetch_depth,
+                    const std::string& image_pattern)
 {
-    std::ifstream stream{filename, std::ios::binary};
-    std::vector<float> density_data(128 * 128 * 128);
-    stream.read((char*)(density_data.data()), sizeof(float) * 128 * 128 * 128);
-    return density_data;
+    scene::VolumeVoxelGrid tracer{};
+    const sf::Vector2u image_size{640, 480};
+    render::Context render_context{image_size};
+    const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
+
+    sequence::FramePrefetcher prefetcher{first_frame, last_frame, prefetch_depth,
+                                         [&grid_pattern](int frame)
+                                         {
+                                             primitives::Box box{};
+                                             box.load_density(sequence::frame_filename(grid_pattern, frame));
+                                             return box;
+                                         }};
+    sf::Clock sequence_clock;
+    try
+    {
+        while (std::optional<sequence::Frame> frame = prefetcher.next())
+        {
+            sf::Clock render_clock;
+            render_context.set_frame(static_cast<std::uint32_t>(frame->number));
+            render_context.set_output({.path = sequence::frame_filename(image_pattern, frame->number)});
+            render_context.render_image(ray_origin, frame->box, tracer);
+            std::cout << "Frame " << frame->number << " rendered in " << render_clock.restart().asSeconds()
+                      << " seconds\n";
+        }
+        render_context.flush_output();
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+
+    std::cout << "Sequence done! Time elapsed: " << sequence_clock.restart().asSeconds() << " seconds\n";
+    return 0;
 }
 
-int main()
+// Whole argument as an integer, or nothing if it holds anything else
+std::optional<int> parse_int(const std::string& argument)
 {
-    primitives::Box box{};
-    box.density = read_density_from_file();
-    std::unique_ptr<scene::SceneTracer> tracer{std::make_unique<scene::VolumeVoxelGrid>()};
+    int value{0};
+    const char* end{argument.data() + argument.size()};
+    const auto [last, error] = std::from_chars(argument.data(), end, value);
+    if (error != std::errc{} || last != end)
+    {
+        return std::nullopt;
+    }
+    return value;
+}
+
+int main(int argc, char* argv[])
+{
+    const std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (!arguments.empty() && arguments.front() == "--sequence")
+    {
+        const std::optional<int> first_frame{arguments.size() > 2 ? parse_int(arguments[2]) : std::nullopt};
+        const std::optional<int> last_frame{arguments.size() > 3 ? parse_int(arguments[3]) : std::nullopt};
+        const std::optional<int> prefetch_depth{arguments.size() > 4 ? parse_int(arguments[4]) : 2};
+        if (!first_frame || !last_frame || !prefetch_depth || *prefetch_depth < 1)
+        {
+            std::cerr << "Usage: fluid --sequence <grid pattern, e.g. cachefiles/grid.{}.bin> <first frame> "
+                         "<last frame> [prefetch depth >= 1, default 2] [image pattern = grid_volume.{}.png]\n";
+            return 1;
+        }
+        return render_sequence(arguments[1], *first_frame, *last_frame, static_cast<std::size_t>(*prefetch_depth),
+                               arguments.size() > 5 ? arguments[5] : "grid_volume.{}.png");
+    }
 
     const sf::Vector2u image_size{640, 480};
     const sf::Vector3f background{0.0f, 1.0f, 1.0f};
     render::Context render_context{image_size};
+    try
+    {
+        primitives::Box box{};
+        box.load_density(arguments.empty() ? "cachefiles/grid.40.bin" : arguments.front());
+        std::cout << "Loaded " << box.density.allocated_bricks() << " bricks ("
+                  << (box.density.memory_usage() / (1024.0 * 1024.0)) << " MB)\n";
+        scene::VolumeVoxelGrid tracer{};
 
-    sf::Clock render_clock;
-    std::cout << "Rendering image..." << std::endl;
-    const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
-    render_context.render_image(ray_origin, box, *tracer);
-    std::cout << "Done! Time elapsed: " << render_clock.restart().asSeconds() << " seconds\n";
+        sf::Clock render_clock;
+        std::cout << "Rendering image..." << std::endl;
+        const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
+        render_context.render_image(ray_origin, box, tracer);
+        render_context.flush_output();
+        std::cout << "Done! Time elapsed: " << render_clock.restart().asSeconds() << " seconds\n";
+        if constexpr (stats::enabled)
+        {
+            stats::print(std::cout, render_context.frame_stats());
+        }
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
 
     sf::RenderWindow window{sf::VideoMode{image_size.x, image_size.y}, "Volume Renderer"};
+    render::Display display{render_context.image()};
 
     while (window.isOpen())
     {
@@ -59,7 +143,7 @@ int main()
         }
 
         window.clear(sf::Color::Black);
-        render_context.draw(window);
+        display.draw(window);
         window.display();
     }
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <limits>
+
+#include "framebuffer.hpp"
+
+namespace render
+{
+
+namespace
+{
+
+template <typename T, typename Deleter>
+std::unique_ptr<T[], Deleter> allocate_aligned(std::size_t count)
+{
+    const std::size_t bytes{count * sizeof(T)};
+    T* memory{static_cast<T*>(::operator new[](bytes, std::align_val_t{FrameBuffer::cache_line_size}))};
+    std::uninitialized_value_construct_n(memory, count);
+    return std::unique_ptr<T[], Deleter>{memory};
+}
+
+} // namespace
+
+float luminance(const sf::Vector3f& color)
+{
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+FrameBuffer::FrameBuffer(const sf::Vector2u& size) :
+    size_{size}, row_stride_{(static_cast<std::size_t>(size.x) + 15) / 16 * 16},
+    pixels_{allocate_aligned<Pixel, AlignedDelete>(row_stride_ * size_.y)},
+    luminance_squares_{allocate_aligned<float, AlignedDelete>(row_stride_ * size_.y)}
+{
+}
+
+const sf::Vector2u& FrameBuffer::size() const
+{
+    return size_;
+}
+
+void FrameBuffer::clear()
+{
+    std::fill_n(pixels_.get(), row_stride_ * size_.y, Pixel{});
+    std::fill_n(luminance_squares_.get(), row_stride_ * size_.y, 0.0f);
+}
+
+void FrameBuffer::fill(const sf::Vector3f& color)
+{
+    const Pixel sample{.r = color.x, .g = color.y, .b = color.z, .count = 1.0f};
+    const float luminance_square{luminance(color) * luminance(color)};
+    std::fill_n(pixels_.get(), row_stride_ * size_.y, sample);
+    std::fill_n(luminance_squares_.get(), row_stride_ * size_.y, luminance_square);
+}
+
+sf::Vector3f FrameBuffer::mean(std::uint32_t x, std::uint32_t y) const
+{
+    const Pixel& sum{pixel(x, y)};
+    if (sum.count <= 0.0f)
+    {
+        return {};
+    }
+    return sf::Vector3f{sum.r, sum.g, sum.b} / sum.count;
+}
+
+float FrameBuffer::mean_variance(std::uint32_t x, std::uint32_t y) const
+{
+    const Pixel& sum{pixel(x, y)};
+    if (sum.count < 2.0f)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+    const float mean_luminance{luminance(sf::Vector3f{sum.r, sum.g, sum.b}) / sum.count};
+    const float sample_variance{(luminance_squares_[index(x, y)] - sum.count * mean_luminance * mean_luminance) /
+                                (sum.count - 1.0f)};
+    return std::max(sample_variance, 0.0f) / sum.count;
+}
+
+void FrameBuffer::means(std::vector<float>& rgb) const
+{
+    rgb.resize(static_cast<std::size_t>(size_.x) * size_.y * 3);
+#pragma omp parallel for
+    for (std::uint32_t y = 0; y < size_.y; ++y)
+    {
+        const Pixel* row{pixels_.get() + index(0, y)};
+        float* output{rgb.data() + static_cast<std::size_t>(y) * size_.x * 3};
+#pragma omp simd
+        for (std::uint32_t x = 0; x < size_.x; ++x)
+        {
+            const float scale{row[x].count > 0.0f ? 1.0f / row[x].count : 0.0f};
+            output[3 * x + 0] = row[x].r * scale;
+            output[3 * x + 1] = row[x].g * scale;
+            output[3 * x + 2] = row[x].b * scale;
+        }
+    }
+}
+
+void FrameBuffer::resolve(sf::Image& image, ToneMapping tone_mapping, float exposure) const
+{
+    std::vector<std::uint8_t> rgba(static_cast<std::size_t>(size_.x) * size_.y * 4);
+#pragma omp parallel for
+    for (std::uint32_t y = 0; y < size_.y; ++y)
+    {
+        const Pixel* row{pixels_.get() + index(0, y)};
+        std::uint8_t* output{rgba.data() + static_cast<std::size_t>(y) * size_.x * 4};
+#pragma omp simd
+        for (std::uint32_t x = 0; x < size_.x; ++x)
+        {
+            const float scale{row[x].count > 0.0f ? 1.0f / row[x].count : 0.0f};
+            output[4 * x + 0] = tone_map(row[x].r * scale, tone_mapping, exposure);
+            output[4 * x + 1] = tone_map(row[x].g * scale, tone_mapping, exposure);
+            output[4 * x + 2] = tone_map(row[x].b * scale, tone_mapping, exposure);
+            output[4 * x + 3] = 255;
+        }
+    }
+    image.create(size_.x, size_.y, rgba.data());
+}
+
+} // namespace render
@@ -0,0 +1,114 @@
+#ifndef FRAMEBUFFER_HPP
+#define FRAMEBUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+#include <SFML/System/Vector3.hpp>
+
+namespace render
+{
+
+enum class ToneMapping
+{
+    // Clamps each channel to [0, 1], like util::vector_to_color
+    Clamp,
+    // c / (1 + c), compresses highlights instead of clipping them
+    Reinhard
+};
+
+// Maps an HDR channel value to 8 bits
+inline std::uint8_t tone_map(float value, ToneMapping tone_mapping, float exposure)
+{
+    value *= exposure;
+    value = tone_mapping == ToneMapping::Reinhard ? value / (1.0f + value) : value;
+    return static_cast<std::uint8_t>((value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value)) * 255.0f);
+}
+
+/*
+
+HDR accumulation buffer: per pixel the float sum of its samples, their count and the
+sum of squared sample luminances, so the mean and its variance are known at any time.
+
+Rows are padded to a multiple of 16 pixels and storage is cache-line aligned, so the
+16 pixel wide render tiles of different threads never share a cache line. resolve
+converts the whole buffer to 8 bits in one pass.
+
+*/
+
+class FrameBuffer
+{
+public:
+    static constexpr std::size_t cache_line_size{64};
+
+    struct alignas(16) Pixel
+    {
+        float r{0.0f};
+        float g{0.0f};
+        float b{0.0f};
+        float count{0.0f};
+    };
+
+    explicit FrameBuffer(const sf::Vector2u& size);
+
+    const sf::Vector2u& size() const;
+    void clear();
+    // Replaces every pixel with one sample of color
+    void fill(const sf::Vector3f& color);
+
+    // Adds count samples that sum to color_sum and whose squared luminances sum to luminance_squares
+    void add_samples(std::uint32_t x, std::uint32_t y, const sf::Vector3f& color_sum, float luminance_squares,
+                     std::uint32_t count)
+    {
+        Pixel& pixel{pixels_[index(x, y)]};
+        pixel.r += color_sum.x;
+        pixel.g += color_sum.y;
+        pixel.b += color_sum.z;
+        pixel.count += static_cast<float>(count);
+        luminance_squares_[index(x, y)] += luminance_squares;
+    }
+
+    const Pixel& pixel(std::uint32_t x, std::uint32_t y) const
+    {
+        return pixels_[index(x, y)];
+    }
+
+    sf::Vector3f mean(std::uint32_t x, std::uint32_t y) const;
+    // Estimated variance of the mean luminance of a pixel; infinite below two samples
+    float mean_variance(std::uint32_t x, std::uint32_t y) const;
+
+    // Copies the per-pixel means into rgb as rows of RGB floats without padding
+    void means(std::vector<float>& rgb) const;
+    // Writes exposure-scaled, tone mapped means into image, resizing it if needed
+    void resolve(sf::Image& image, ToneMapping tone_mapping = ToneMapping::Clamp, float exposure = 1.0f) const;
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(void* memory) const
+        {
+            ::operator delete[](memory, std::align_val_t{cache_line_size});
+        }
+    };
+
+    const sf::Vector2u size_;
+    const std::size_t row_stride_;
+    std::unique_ptr<Pixel[], AlignedDelete> pixels_;
+    std::unique_ptr<float[], AlignedDelete> luminance_squares_;
+
+    std::size_t index(std::uint32_t x, std::uint32_t y) const
+    {
+        return y * row_stride_ + x;
+    }
+};
+
+float luminance(const sf::Vector3f& color);
+
+} // namespace render
+
+#endif // FRAMEBUFFER_HPP
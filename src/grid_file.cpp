@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "grid_file.hpp"
+#include "mapped_file.hpp"
+
+namespace grid
+{
+
+namespace
+{
+
+constexpr std::array<char, 8> file_magic{'V', 'O', 'L', 'G', 'R', 'I', 'D', '\0'};
+constexpr std::uint32_t file_version{1};
+constexpr std::uint32_t byte_order_mark{0x01020304};
+constexpr std::uint64_t section_alignment{64};
+
+struct FileHeader
+{
+    std::array<char, 8> magic{file_magic};
+    std::uint32_t version{file_version};
+    std::uint32_t byte_order{byte_order_mark};
+    std::array<std::int32_t, 3> resolution{};
+    std::int32_t brick_size{SparseGrid::brick_size};
+    std::array<float, 3> bounds_min{};
+    std::array<float, 3> bounds_max{};
+    std::uint32_t channel_count{0};
+    std::uint32_t reserved{0};
+};
+
+struct ChannelHeader
+{
+    std::array<char, 32> name{};
+    std::uint32_t encoding{0};
+    std::uint32_t brick_count{0};
+    std::uint64_t table_offset{0};
+    std::uint64_t ranges_offset{0};
+    std::uint64_t data_offset{0};
+    std::uint64_t data_size{0};
+};
+
+static_assert(sizeof(FileHeader) == 64 && std::is_trivially_copyable_v<FileHeader>);
+static_assert(sizeof(ChannelHeader) == 72 && std::is_trivially_copyable_v<ChannelHeader>);
+static_assert(sizeof(SparseGrid::BrickRange) == 12 && std::is_trivially_copyable_v<SparseGrid::BrickRange>);
+
+std::uint64_t align(std::uint64_t offset)
+{
+    return (offset + section_alignment - 1) / section_alignment * section_alignment;
+}
+
+template <typename T>
+std::span<const T> section(std::span<const std::uint8_t> bytes, std::uint64_t offset, std::uint64_t count)
+{
+    if (offset % alignof(T) != 0 || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T))
+    {
+        throw std::runtime_error{"Grid file section is out of bounds"};
+    }
+    return {reinterpret_cast<const T*>(bytes.data() + offset), static_cast<std::size_t>(count)};
+}
+
+} // namespace
+
+const SparseGrid& GridFile::channel(const std::string& name) const
+{
+    const auto found{std::find_if(channels.begin(), channels.end(),
+                                  [&name](const GridChannel& channel) { return channel.name == name; })};
+    if (found == channels.end())
+    {
+        throw std::runtime_error{"Grid file has no channel " + name};
+    }
+    return found->grid;
+}
+
+void write_grid_file(const std::string& filename, const GridFile& file)
+{
+    FileHeader header{};
+    header.bounds_min = {file.bounds[0].x, file.bounds[0].y, file.bounds[0].z};
+    header.bounds_max = {file.bounds[1].x, file.bounds[1].y, file.bounds[1].z};
+    header.channel_count = static_cast<std::uint32_t>(file.channels.size());
+    if (!file.channels.empty())
+    {
+        header.resolution.fill(file.channels.front().grid.resolution());
+    }
+
+    std::vector<ChannelHeader> channel_headers(file.channels.size());
+    std::uint64_t offset{sizeof(FileHeader) + (sizeof(ChannelHeader) * channel_headers.size())};
+    for (std::size_t i = 0; i < file.channels.size(); ++i)
+    {
+        const SparseGrid& grid{file.channels[i].grid};
+        if (grid.resolution() != header.resolution[0])
+        {
+            throw std::invalid_argument{"Grid file channels must share the same resolution"};
+        }
+
+        ChannelHeader& channel{channel_headers[i]};
+        const std::string& name{file.channels[i].name};
+        std::memcpy(channel.name.data(), name.data(), std::min(name.size(), channel.name.size() - 1));
+        channel.encoding = static_cast<std::uint32_t>(grid.encoding());
+        channel.brick_count = static_cast<std::uint32_t>(grid.allocated_bricks());
+        channel.table_offset = align(offset);
+        channel.ranges_offset = align(channel.table_offset + grid.brick_table().size_bytes());
+        channel.data_offset = align(channel.ranges_offset + grid.brick_ranges().size_bytes());
+        channel.data_size = grid.brick_data().size_bytes();
+        offset = channel.data_offset + channel.data_size;
+    }
+
+    std::ofstream stream{filename, std::ios::binary | std::ios::trunc};
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to create grid file " + filename};
+    }
+
+    std::uint64_t position{0};
+    const auto write = [&](const void* data, std::uint64_t size)
+    {
+        stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        position += size;
+    };
+    const auto pad_to = [&](std::uint64_t target)
+    {
+        const std::array<char, section_alignment> zeros{};
+        write(zeros.data(), target - position);
+    };
+
+    write(&header, sizeof(header));
+    write(channel_headers.data(), sizeof(ChannelHeader) * channel_headers.size());
+    for (std::size_t i = 0; i < file.channels.size(); ++i)
+    {
+        const SparseGrid& grid{file.channels[i].grid};
+        pad_to(channel_headers[i].table_offset);
+        write(grid.brick_table().data(), grid.brick_table().size_bytes());
+        pad_to(channel_headers[i].ranges_offset);
+        write(grid.brick_ranges().data(), grid.brick_ranges().size_bytes());
+        pad_to(channel_headers[i].data_offset);
+        write(grid.brick_data().data(), grid.brick_data().size_bytes());
+    }
+
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to write grid file " + filename};
+    }
+}
+
+GridFile load_grid_file(const std::string& filename)
+{
+    const auto mapping{std::make_shared<const io::MappedFile>(filename)};
+    const std::span<const std::uint8_t> bytes{mapping->bytes()};
+
+    FileHeader header{};
+    if (bytes.size() < sizeof(header))
+    {
+        throw std::runtime_error{filename + " is not a grid file"};
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != file_magic)
+    {
+        throw std::runtime_error{filename + " is not a grid file"};
+    }
+    if (header.version != file_version || header.byte_order != byte_order_mark)
+    {
+        throw std::runtime_error{filename + " has an unsupported version or byte order"};
+    }
+    if (header.brick_size != SparseGrid::brick_size || header.resolution[0] <= 0 ||
+        header.resolution[1] != header.resolution[0] || header.resolution[2] != header.resolution[0])
+    {
+        throw std::runtime_error{filename + " has an unsupported grid layout"};
+    }
+
+    GridFile file{};
+    file.bounds = {glm::vec3{header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]},
+                   glm::vec3{header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]}};
+
+    const int resolution{header.resolution[0]};
+    const std::uint64_t bricks_per_axis{static_cast<std::uint64_t>((resolution + SparseGrid::brick_size - 1) /
+                                                                   SparseGrid::brick_size)};
+    const std::span<const ChannelHeader> channel_headers{
+        section<ChannelHeader>(bytes, sizeof(FileHeader), header.channel_count)};
+    for (const ChannelHeader& channel : channel_headers)
+    {
+        if (channel.encoding > static_cast<std::uint32_t>(Encoding::UInt8))
+        {
+            throw std::runtime_error{filename + " has a channel with an unknown encoding"};
+        }
+
+        const auto encoding{static_cast<Encoding>(channel.encoding)};
+        const std::uint64_t data_size{static_cast<std::uint64_t>(channel.brick_count) * SparseGrid::brick_voxels *
+                                      bytes_per_voxel(encoding)};
+        if (channel.data_size != data_size)
+        {
+            throw std::runtime_error{filename + " has a truncated channel"};
+        }
+
+        file.channels.push_back(GridChannel{
+            .name = std::string{channel.name.begin(), std::find(channel.name.begin(), channel.name.end(), '\0')},
+            .grid = SparseGrid::from_external(
+                resolution, encoding,
+                section<std::int32_t>(bytes, channel.table_offset, bricks_per_axis * bricks_per_axis * bricks_per_axis),
+                section<SparseGrid::BrickRange>(bytes, channel.ranges_offset, channel.brick_count),
+                section<std::uint8_t>(bytes, channel.data_offset, data_size), mapping)});
+    }
+    return file;
+}
+
+} // namespace grid
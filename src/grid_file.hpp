@@ -0,0 +1,52 @@
+#ifndef GRID_FILE_HPP
+#define GRID_FILE_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sparse_grid.hpp"
+
+namespace grid
+{
+
+/*
+
+Self-describing grid cache (.vgrid).
+
+Layout (native little-endian):
+    FileHeader: magic, version, resolution, brick size, world bounds, channel count
+    ChannelHeader[channel_count]: name, encoding and byte offsets of the channel arrays
+    per channel: brick table, brick ranges and encoded brick voxels, each 64-byte aligned
+
+The arrays are exactly those of SparseGrid, so loading maps the file and points the
+grids straight at the mapped pages; nothing is read or decoded up front.
+
+*/
+
+struct GridChannel
+{
+    std::string name;
+    SparseGrid grid;
+};
+
+struct GridFile
+{
+    std::array<glm::vec3, 2> bounds{};
+    std::vector<GridChannel> channels;
+
+    // Throws if the file has no channel with this name
+    const SparseGrid& channel(const std::string& name) const;
+};
+
+constexpr const char* grid_file_extension{".vgrid"};
+
+// All channels must share the same resolution
+void write_grid_file(const std::string& filename, const GridFile& file);
+GridFile load_grid_file(const std::string& filename);
+
+} // namespace grid
+
+#endif // GRID_FILE_HPP
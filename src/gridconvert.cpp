@@ -0,0 +1,67 @@
+#include <charconv>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "grid_file.hpp"
+#include "primitives.hpp"
+#include "sparse_grid.hpp"
+
+// Converts a raw z-y-x float cache (e.g. cachefiles/grid.40.bin) into a .vgrid file
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: gridconvert <input.bin> <output" << grid::grid_file_extension
+                  << "> [resolution = 128] [float32 | float16 | uint8]\n";
+        return 1;
+    }
+
+    const std::string input{argv[1]};
+    const std::string output{argv[2]};
+    int resolution{128};
+    if (argc > 3)
+    {
+        const std::string argument{argv[3]};
+        const char* end{argument.data() + argument.size()};
+        const auto [last, error] = std::from_chars(argument.data(), end, resolution);
+        if (error != std::errc{} || last != end || resolution <= 0)
+        {
+            std::cerr << "Resolution must be a positive integer, got " << argument << '\n';
+            return 1;
+        }
+    }
+    const std::string encoding_name{argc > 4 ? argv[4] : "float32"};
+
+    grid::Encoding encoding{grid::Encoding::Float32};
+    if (encoding_name == "float16")
+    {
+        encoding = grid::Encoding::Float16;
+    }
+    else if (encoding_name == "uint8")
+    {
+        encoding = grid::Encoding::UInt8;
+    }
+    else if (encoding_name != "float32")
+    {
+        std::cerr << "Unknown encoding " << encoding_name << '\n';
+        return 1;
+    }
+
+    try
+    {
+        grid::GridFile file{};
+        file.bounds = primitives::Box{}.bounds;
+        file.channels.push_back(
+            grid::GridChannel{.name = "density", .grid = grid::SparseGrid::read_raw(input, resolution, encoding)});
+        grid::write_grid_file(output, file);
+        const grid::SparseGrid& density{file.channels.front().grid};
+        std::cout << "Wrote " << output << ": " << density.allocated_bricks() << " bricks, "
+                  << (density.memory_usage() / (1024.0 * 1024.0)) << " MB\n";
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,347 @@
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <variant>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <SFML/System/Clock.hpp>
+#include <glm/glm.hpp>
+
+#include "context.hpp"
+#include "march.hpp"
+#include "output.hpp"
+#include "primitives.hpp"
+#include "sampler.hpp"
+#include "scene_tracer.hpp"
+#include "stats.hpp"
+
+/*
+
+Batch renderer without window, texture or ImGui.
+
+Settings are "key = value" lines of an optional scene file, overridden by "--key value"
+command line arguments:
+    chapter     tracer chapter, 1 to 7 (5 and 6 render a voxel grid, the others a sphere)
+    width, height, samples, frame, threads (0 keeps the OpenMP default)
+    adaptive_error    relative noise at which pixels stop sampling; enables adaptive sampling
+    min_samples, max_samples, sample_budget, time_budget    limits of adaptive sampling
+    output      image path; .pfm and .raw write HDR floats, other extensions 8-bit images
+    tone_mapping, exposure    clamp or reinhard, and a scale applied before it
+    grid        density cache for chapters 5 and 6 (.vgrid or raw 128^3 floats)
+    filter      grid lookups: nearest, trilinear or tricubic
+    absorption, scattering, density, radius    volume parameters
+    step_tolerance    error tolerance of adaptive ray marching for chapter 4 (0 keeps fixed steps)
+    deterministic     1 renders chapters 4 and 5 without jitter or Russian roulette along the rays
+    heatmap     image path for the per-pixel cost map; needs a build with VOLRENDER_STATS, which also
+                prints hot-path counters and per-thread load after the render
+    heatmap_metric    cost shown by the heatmap: time or events
+
+*/
+
+struct Options
+{
+    scene::Chapters chapter{scene::Chapters::VolumeComplete};
+    sf::Vector2u image_size{640, 480};
+    std::uint32_t samples{1};
+    render::AdaptiveSampling adaptive_sampling{};
+    std::uint32_t frame{0};
+    int threads{0};
+    output::OutputSettings output{.path = "render.png"};
+    std::string grid{"cachefiles/grid.40.bin"};
+    march::AdaptiveSettings adaptive_step{};
+    bool deterministic{false};
+    primitives::Sphere sphere{};
+    primitives::Box box{};
+    std::string heatmap{};
+    stats::HeatmapMetric heatmap_metric{stats::HeatmapMetric::Time};
+};
+
+void apply_setting(Options& options, const std::string& key, const std::string& value)
+{
+    if (key == "chapter")
+    {
+        const int chapter{std::stoi(value)};
+        if (chapter < 1 || chapter > static_cast<int>(scene::Chapters::NumberOfChapters))
+        {
+            throw std::invalid_argument{"Chapter must be between 1 and " +
+                                        std::to_string(static_cast<int>(scene::Chapters::NumberOfChapters))};
+        }
+        options.chapter = static_cast<scene::Chapters>(chapter - 1);
+    }
+    else if (key == "width")
+    {
+        options.image_size.x = static_cast<unsigned int>(std::stoul(value));
+    }
+    else if (key == "height")
+    {
+        options.image_size.y = static_cast<unsigned int>(std::stoul(value));
+    }
+    else if (key == "samples")
+    {
+        options.samples = static_cast<std::uint32_t>(std::stoul(value));
+    }
+    else if (key == "adaptive_error")
+    {
+        options.adaptive_sampling.enabled = true;
+        options.adaptive_sampling.relative_error = std::stof(value);
+    }
+    else if (key == "min_samples")
+    {
+        options.adaptive_sampling.min_samples = static_cast<std::uint32_t>(std::stoul(value));
+    }
+    else if (key == "max_samples")
+    {
+        options.adaptive_sampling.max_samples = static_cast<std::uint32_t>(std::stoul(value));
+    }
+    else if (key == "sample_budget")
+    {
+        options.adaptive_sampling.sample_budget = std::stoull(value);
+    }
+    else if (key == "time_budget")
+    {
+        options.adaptive_sampling.time_budget = std::stof(value);
+    }
+    else if (key == "frame")
+    {
+        options.frame = static_cast<std::uint32_t>(std::stoul(value));
+    }
+    else if (key == "threads")
+    {
+        options.threads = std::stoi(value);
+    }
+    else if (key == "output")
+    {
+        options.output.path = value;
+    }
+    else if (key == "tone_mapping")
+    {
+        if (value != "clamp" && value != "reinhard")
+        {
+            throw std::invalid_argument{"Tone mapping must be clamp or reinhard"};
+        }
+        options.output.tone_mapping = value == "clamp" ? render::ToneMapping::Clamp : render::ToneMapping::Reinhard;
+    }
+    else if (key == "exposure")
+    {
+        options.output.exposure = std::stof(value);
+    }
+    else if (key == "grid")
+    {
+        options.grid = value;
+    }
+    else if (key == "filter")
+    {
+        if (value == "nearest")
+        {
+            options.box.set_filter(sampler::Filter::Nearest);
+        }
+        else if (value == "trilinear")
+        {
+            options.box.set_filter(sampler::Filter::Trilinear);
+        }
+        else if (value == "tricubic")
+        {
+            options.box.set_filter(sampler::Filter::Tricubic);
+        }
+        else
+        {
+            throw std::invalid_argument{"Filter must be nearest, trilinear or tricubic"};
+        }
+    }
+    else if (key == "step_tolerance")
+    {
+        options.adaptive_step.tolerance = std::stof(value);
+    }
+    else if (key == "deterministic")
+    {
+        options.deterministic = std::stoi(value) != 0;
+    }
+    else if (key == "absorption")
+    {
+        options.sphere.absorption_coeff = options.box.absorption_coeff = std::stof(value);
+    }
+    else if (key == "scattering")
+    {
+        options.sphere.scattering_coeff = options.box.scattering_coeff = std::stof(value);
+    }
+    else if (key == "density")
+    {
+        options.sphere.density = std::stof(value);
+    }
+    else if (key == "radius")
+    {
+        options.sphere.radius = std::stof(value);
+    }
+    else if (key == "heatmap")
+    {
+        options.heatmap = value;
+    }
+    else if (key == "heatmap_metric")
+    {
+        if (value != "time" && value != "events")
+        {
+            throw std::invalid_argument{"Heatmap metric must be time or events"};
+        }
+        options.heatmap_metric = value == "time" ? stats::HeatmapMetric::Time : stats::HeatmapMetric::Events;
+    }
+    else
+    {
+        throw std::invalid_argument{"Unknown setting " + key};
+    }
+}
+
+std::string trim(const std::string& text)
+{
+    const std::size_t first{text.find_first_not_of(" \t\r")};
+    const std::size_t last{text.find_last_not_of(" \t\r")};
+    return first == std::string::npos ? std::string{} : text.substr(first, last - first + 1);
+}
+
+void read_scene_file(Options& options, const std::string& filename)
+{
+    std::ifstream stream{filename};
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to open scene file " + filename};
+    }
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+
+        const std::size_t separator{line.find('=')};
+        if (separator == std::string::npos)
+        {
+            throw std::invalid_argument{"Expected key = value in scene file, got: " + line};
+        }
+        apply_setting(options, trim(line.substr(0, separator)), trim(line.substr(separator + 1)));
+    }
+}
+
+Options parse_options(const std::vector<std::string>& arguments)
+{
+    Options options{};
+    // The scene file is applied first wherever it appears, so command line settings override it
+    for (std::size_t i = 0; i + 1 < arguments.size(); ++i)
+    {
+        if (arguments[i] == "--scene")
+        {
+            read_scene_file(options, arguments[i + 1]);
+        }
+    }
+
+    for (std::size_t i = 0; i < arguments.size(); i += 2)
+    {
+        if (!arguments[i].starts_with("--") || i + 1 >= arguments.size())
+        {
+            throw std::invalid_argument{"Expected --key value, got: " + arguments[i]};
+        }
+        if (arguments[i] != "--scene")
+        {
+            apply_setting(options, arguments[i].substr(2), arguments[i + 1]);
+        }
+    }
+
+    if (options.deterministic && options.chapter != scene::Chapters::VolumeDensityField &&
+        options.chapter != scene::Chapters::VolumeVoxelGrid)
+    {
+        throw std::invalid_argument{"Deterministic rendering is only available for chapters 4 and 5"};
+    }
+    return options;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const Options options{parse_options(std::vector<std::string>(argv + 1, argv + argc))};
+#ifdef _OPENMP
+        if (options.threads > 0)
+        {
+            omp_set_num_threads(options.threads);
+        }
+#endif
+
+        render::Context render_context{options.image_size};
+        render_context.set_output(options.output);
+        render_context.set_frame(options.frame);
+        render_context.set_samples_per_pixel(options.samples);
+        render_context.set_adaptive_sampling(options.adaptive_sampling);
+
+        sf::Clock render_clock;
+        const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
+        // Takes the chapter's tracer variant or one of the deterministic policy tracers
+        const auto render = [&](auto& tracer)
+        {
+            if (options.chapter == scene::Chapters::VolumeVoxelGrid ||
+                options.chapter == scene::Chapters::VolumeDeltaTracking)
+            {
+                primitives::Box box{options.box};
+                box.load_density(options.grid);
+                render_context.render_image(ray_origin, box, tracer);
+            }
+            else
+            {
+                primitives::Sphere sphere{options.sphere};
+                render_context.render_image(ray_origin, sphere, tracer);
+            }
+        };
+
+        if (options.deterministic && options.chapter == scene::Chapters::VolumeDensityField)
+        {
+            scene::BasicVolumeDensityField<scene::DeterministicPolicy> tracer{};
+            tracer.adaptive_step = options.adaptive_step;
+            render(tracer);
+        }
+        else if (options.deterministic)
+        {
+            scene::BasicVolumeVoxelGrid<scene::DeterministicPolicy> tracer{};
+            render(tracer);
+        }
+        else
+        {
+            scene::Tracer tracer{scene::make_tracer_variant(options.chapter)};
+            if (auto* density_field = std::get_if<scene::VolumeDensityField>(&tracer))
+            {
+                density_field->adaptive_step = options.adaptive_step;
+            }
+            render(tracer);
+        }
+        // Waits for the image to be written, so a failed write exits with an error like any other failure
+        render_context.flush_output();
+        std::cout << options.output.path << ": " << render_clock.restart().asSeconds() << " seconds, "
+                  << (static_cast<double>(render_context.rendered_samples()) /
+                      (static_cast<double>(options.image_size.x) * options.image_size.y))
+                  << " samples per pixel\n";
+
+        if constexpr (stats::enabled)
+        {
+            stats::print(std::cout, render_context.frame_stats());
+            if (!options.heatmap.empty() &&
+                !render_context.cost_heatmap(options.heatmap_metric).saveToFile(options.heatmap))
+            {
+                throw std::runtime_error{"Failed to write heatmap " + options.heatmap};
+            }
+        }
+        else if (!options.heatmap.empty())
+        {
+            std::cerr << "Heatmap skipped: configure with -DVOLRENDER_STATS=ON to collect render statistics\n";
+        }
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+}
@@ -17,28 +17,54 @@
 #include <SFML/Window/Event.hpp>
 
 #include "context.hpp"
+#include "display.hpp"
 #include "primitives.hpp"
+#include "progressive.hpp"
 #include "ray.hpp"
 #include "scene_tracer.hpp"
+#include "stats.hpp"
 
 int main()
 {
-    bool update{false};
     primitives::Sphere sphere{};
-    std::unique_ptr<scene::SceneTracer> tracer{std::make_unique<scene::VolumeComplete>()};
-    // std::unique_ptr<scene::SceneTracer> tracer{std::make_unique<scene::VolumeDensityField>()};
+    // Chapters rendering the sphere; the voxel grid chapter has its own executable (fluid)
+    constexpr std::array<scene::Chapters, 6> chapters{scene::Chapters::VolumeAbsorption,
+                                                      scene::Chapters::VolumeInScattering,
+                                                      scene::Chapters::VolumeComplete,
+                                                      scene::Chapters::VolumeDensityField,
+                                                      scene::Chapters::VolumeDeltaTracking,
+                                                      scene::Chapters::VolumeSingleScattering};
+    constexpr std::array<const char*, 6> chapter_names{"1 - Absorption", "2 - In-scattering", "3 - Complete",
+                                                       "4 - Density field", "6 - Delta tracking",
+                                                       "7 - Single scattering"};
+    int chapter_index{2};
+    // Each render pass keeps its tracer alive, so switching chapters never replaces one that is rendering
+    auto tracer{std::make_shared<scene::Tracer>(scene::make_tracer_variant(chapters[chapter_index]))};
 
     const sf::Vector2u image_size{640, 480};
     const sf::Vector3f background{0.0f, 1.0f, 1.0f};
     render::Context render_context{image_size};
+    render_context.set_output({.enabled = false});
 
-    sf::Clock render_clock;
-    std::cout << "Rendering image..." << std::endl;
+    // Renders on a background thread; every parameter change restarts the accumulation
     const glm::vec3 ray_origin{0.0f, 0.0f, 0.0f};
-    render_context.render_image(ray_origin, sphere, *tracer);
-    std::cout << "Done! Time elapsed: " << render_clock.restart().asSeconds() << " seconds\n";
+    render::ProgressiveRenderer progressive{render_context};
+    const auto restart_render = [&]
+    {
+        progressive.restart([tracer, sphere, ray_origin](render::Context& context, std::stop_token stop)
+                            {
+                                return context.render_image(ray_origin, sphere, *tracer, stop);
+                            });
+    };
+    restart_render();
 
     sf::RenderWindow window{sf::VideoMode{image_size.x, image_size.y}, "Volume Renderer"};
+    window.setFramerateLimit(60);
+    sf::Image preview{};
+    preview.create(image_size.x, image_size.y, sf::Color::Black);
+    render::Display display{preview};
+    sf::Image heatmap{};
+    bool show_heatmap{false};
     sf::Clock delta_clock;
     bool imgui_init = ImGui::SFML::Init(window);
     if (!imgui_init)
@@ -59,24 +85,42 @@ int main()
             }
         }
 
+        if (progressive.take_image(preview))
+        {
+            display.update(preview);
+        }
+        if (progressive.take_heatmap(heatmap))
+        {
+            display.update_overlay(heatmap);
+        }
+
         ImGui::SFML::Update(window, delta_clock.restart());
         ImGui::Begin("Settings");
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
                     ImGui::GetIO().Framerate);
+        ImGui::Text("Samples per pixel: %u", progressive.published_samples());
+        if (ImGui::Combo("Chapter", &chapter_index, chapter_names.data(), static_cast<int>(chapter_names.size())))
+        {
+            tracer = std::make_shared<scene::Tracer>(scene::make_tracer_variant(chapters[chapter_index]));
+            restart_render();
+        }
+        // Per-pixel render time, counted only in builds with VOLRENDER_STATS
+        if (stats::enabled && ImGui::Checkbox("Cost heatmap", &show_heatmap))
+        {
+            display.set_overlay_visible(show_heatmap);
+        }
         if (ImGui::TreeNode("Volume"))
         {
-            update = ImGui::SliderFloat("Absorption Coefficient", &sphere.absorption_coeff, 0.0f, 1.0f);
-            if (update)
+            if (ImGui::SliderFloat("Absorption Coefficient", &sphere.absorption_coeff, 0.0f, 1.0f))
             {
-                render_context.render_image(ray_origin, sphere, *tracer);
-                update = false;
+                restart_render();
             }
             ImGui::TreePop();
         }
         ImGui::End();
 
         window.clear(sf::Color::Black);
-        render_context.draw(window);
+        display.draw(window);
         ImGui::SFML::Render(window);
         window.display();
     }
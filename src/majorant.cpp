@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "majorant.hpp"
+
+namespace majorant
+{
+
+void MajorantGrid::build(const grid::SparseGrid& density, int dilation)
+{
+    levels_.clear();
+    resolutions_.clear();
+    if (density.resolution() <= 0)
+    {
+        return;
+    }
+
+    const int bricks{density.bricks_per_axis()};
+    std::vector<float> base(static_cast<std::size_t>(bricks) * bricks * bricks, 0.0f);
+#pragma omp parallel for schedule(static)
+    for (int brick_index = 0; brick_index < bricks * bricks * bricks; ++brick_index)
+    {
+        const glm::ivec3 brick{brick_index % bricks, (brick_index / bricks) % bricks, brick_index / (bricks * bricks)};
+        base[brick_index] = density.brick_max(brick);
+        if (dilation <= 0)
+        {
+            continue;
+        }
+        // A footprint of up to a brick reaches into the 26 neighbouring bricks at most
+        for (int neighbour = 0; neighbour < 27; ++neighbour)
+        {
+            const glm::ivec3 offset{(neighbour % 3) - 1, ((neighbour / 3) % 3) - 1, (neighbour / 9) - 1};
+            base[brick_index] = std::max(base[brick_index], density.brick_max(brick + offset));
+        }
+    }
+    levels_.push_back(std::move(base));
+    resolutions_.push_back(bricks);
+
+    while (resolutions_.back() > 1)
+    {
+        const int fine_resolution{resolutions_.back()};
+        const int coarse_resolution{(fine_resolution + 1) / 2};
+        std::vector<float> coarse(static_cast<std::size_t>(coarse_resolution) * coarse_resolution * coarse_resolution,
+                                  0.0f);
+        const int level{static_cast<int>(levels_.size()) - 1};
+        for (int z = 0; z < coarse_resolution; ++z)
+        {
+            for (int y = 0; y < coarse_resolution; ++y)
+            {
+                for (int x = 0; x < coarse_resolution; ++x)
+                {
+                    float maximum{0.0f};
+                    for (int child = 0; child < 8; ++child)
+                    {
+                        const glm::ivec3 fine{(2 * x) + (child & 1), (2 * y) + ((child >> 1) & 1),
+                                              (2 * z) + ((child >> 2) & 1)};
+                        maximum = std::max(maximum, max_density(level, fine));
+                    }
+                    coarse[(static_cast<std::size_t>(z) * coarse_resolution + y) * coarse_resolution + x] = maximum;
+                }
+            }
+        }
+        levels_.push_back(std::move(coarse));
+        resolutions_.push_back(coarse_resolution);
+    }
+}
+
+int MajorantGrid::levels() const
+{
+    return static_cast<int>(levels_.size());
+}
+
+int MajorantGrid::level_resolution(int level) const
+{
+    return resolutions_[level];
+}
+
+int MajorantGrid::level_brick_size(int level) const
+{
+    return brick_size << level;
+}
+
+float MajorantGrid::max_density(int level, const glm::ivec3& brick) const
+{
+    const int resolution{resolutions_[level]};
+    if (brick.x < 0 || brick.x >= resolution || brick.y < 0 || brick.y >= resolution || brick.z < 0 ||
+        brick.z >= resolution)
+    {
+        return 0.0f;
+    }
+
+    return levels_[level][(static_cast<std::size_t>(brick.z) * resolution + brick.y) * resolution + brick.x];
+}
+
+float MajorantGrid::max_density() const
+{
+    return levels_.empty() ? 0.0f : levels_.back().front();
+}
+
+} // namespace majorant
@@ -0,0 +1,49 @@
+#ifndef MAJORANT_HPP
+#define MAJORANT_HPP
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "sparse_grid.hpp"
+
+namespace majorant
+{
+
+/*
+
+Max-density pyramid over a cubic voxel grid.
+
+Level 0 stores the maximum density of each brick of the sparse grid; every further level
+halves the resolution, taking the maximum of 2^3 bricks of the level below, until a single brick
+covers the whole grid. Bricks with a zero majorant are empty and can be skipped by ray traversal;
+non-zero majorants bound the density for estimators that need one. Filtered lookups near a
+brick read voxels of its neighbours, so build() can dilate the bricks by the filter footprint.
+
+*/
+
+class MajorantGrid
+{
+public:
+    static constexpr int brick_size{grid::SparseGrid::brick_size};
+
+    // Bricks also bound the voxels within dilation voxels around them (at most brick_size)
+    void build(const grid::SparseGrid& density, int dilation = 0);
+
+    int levels() const;
+    // Number of bricks per axis on a level
+    int level_resolution(int level) const;
+    // Number of voxels per axis covered by one brick of a level
+    int level_brick_size(int level) const;
+    // Zero for bricks outside of the grid
+    float max_density(int level, const glm::ivec3& brick) const;
+    float max_density() const;
+
+private:
+    std::vector<std::vector<float>> levels_;
+    std::vector<int> resolutions_;
+};
+
+} // namespace majorant
+
+#endif // MAJORANT_HPP
@@ -0,0 +1,124 @@
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+namespace io
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    file_handle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE)
+    {
+        file_handle_ = nullptr;
+        throw std::runtime_error{"Failed to open " + filename};
+    }
+
+    LARGE_INTEGER file_size{};
+    if (!GetFileSizeEx(file_handle_, &file_size))
+    {
+        CloseHandle(file_handle_);
+        throw std::runtime_error{"Failed to query the size of " + filename};
+    }
+    size_ = static_cast<std::size_t>(file_size.QuadPart);
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ == nullptr)
+    {
+        CloseHandle(file_handle_);
+        throw std::runtime_error{"Failed to map " + filename};
+    }
+
+    data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr)
+    {
+        CloseHandle(mapping_handle_);
+        CloseHandle(file_handle_);
+        throw std::runtime_error{"Failed to map " + filename};
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_handle_ != nullptr)
+    {
+        CloseHandle(mapping_handle_);
+    }
+    if (file_handle_ != nullptr)
+    {
+        CloseHandle(file_handle_);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename)
+{
+    const int descriptor{open(filename.c_str(), O_RDONLY)};
+    if (descriptor < 0)
+    {
+        throw std::runtime_error{"Failed to open " + filename};
+    }
+
+    struct stat status{};
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        throw std::runtime_error{"Failed to query the size of " + filename};
+    }
+    size_ = static_cast<std::size_t>(status.st_size);
+    if (size_ == 0)
+    {
+        close(descriptor);
+        return;
+    }
+
+    void* mapping{mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0)};
+    // The mapping keeps its own reference to the file
+    close(descriptor);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error{"Failed to map " + filename};
+    }
+    data_ = static_cast<const std::uint8_t*>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<std::uint8_t*>(data_), size_);
+    }
+}
+
+#endif
+
+std::span<const std::uint8_t> MappedFile::bytes() const
+{
+    return {data_, size_};
+}
+
+} // namespace io
@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace io
+{
+
+/*
+
+Read-only memory mapping of a whole file.
+
+Pages are loaded on first access and, being a shared mapping, live in the OS page cache,
+so several processes mapping the same file share one copy.
+
+*/
+
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::span<const std::uint8_t> bytes() const;
+
+private:
+    const std::uint8_t* data_{nullptr};
+    std::size_t size_{0};
+#ifdef _WIN32
+    void* file_handle_{nullptr};
+    void* mapping_handle_{nullptr};
+#endif
+};
+
+} // namespace io
+
+#endif // MAPPED_FILE_HPP
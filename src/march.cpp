@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <cmath>
+
+#include "march.hpp"
+
+namespace march
+{
+
+StepController::StepController(const AdaptiveSettings& settings, float fixed_step, float extinction_coeff) :
+    settings_{settings}, fixed_step_{fixed_step}, extinction_coeff_{extinction_coeff}, step_{fixed_step}
+{
+    if (settings_.tolerance > 0.0f)
+    {
+        step_ = std::clamp(fixed_step_, settings_.min_step, settings_.max_step);
+    }
+}
+
+float StepController::step() const
+{
+    return step_;
+}
+
+void StepController::update(const float* densities, int count, float transparency, float distance)
+{
+    if (settings_.tolerance <= 0.0f || count <= 0)
+    {
+        return;
+    }
+
+    float variation{previous_density_ < 0.0f ? 0.0f : std::abs(densities[0] - previous_density_)};
+    for (int i = 1; i < count; ++i)
+    {
+        variation = std::max(variation, std::abs(densities[i] - densities[i - 1]));
+    }
+    previous_density_ = densities[count - 1];
+
+    const float slope{variation / step_};
+    const float tolerance{settings_.tolerance * (1.0f + (distance / settings_.distance_scale)) /
+                          std::max(transparency, 1e-3f)};
+    const float error_rate{extinction_coeff_ * slope};
+    const float target{error_rate > 0.0f ? 2.0f * tolerance / error_rate : settings_.max_step};
+    // Growth is limited, so a smooth stretch does not jump over the next feature in one batch
+    step_ = std::clamp(std::min(target, 2.0f * step_), settings_.min_step, settings_.max_step);
+}
+
+} // namespace march
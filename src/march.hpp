@@ -0,0 +1,53 @@
+#ifndef MARCH_HPP
+#define MARCH_HPP
+
+namespace march
+{
+
+/*
+
+Adaptive step control for ray marching.
+
+The error of a midpoint-style Riemann step of length h over a density with local slope g is
+about extinction * g * h^2 / 2, so keeping the error per unit length below a tolerance allows
+h = 2 * tolerance / (extinction * g). The allowed error grows as the accumulated transparency
+falls, since later samples are attenuated by it, and with the distance from the camera, where a
+pixel covers more of the scene. Steps shrink at once but at most double per update, and are
+clamped to [min_step, max_step]; a zero tolerance keeps the fixed step.
+
+The slope is estimated from the densities of the previous batch of steps, so whole batches
+share one step length and can still be evaluated together.
+
+*/
+
+struct AdaptiveSettings
+{
+    // Allowed integration error of the optical depth per unit length; zero disables adaptive steps
+    float tolerance{0.0f};
+    float min_step{0.02f};
+    float max_step{0.5f};
+    // Distance from the camera over which the tolerance grows by one times its value
+    float distance_scale{20.0f};
+};
+
+class StepController
+{
+public:
+    StepController(const AdaptiveSettings& settings, float fixed_step, float extinction_coeff);
+
+    float step() const;
+    // Adapts the step to densities sampled one step() apart, with the transparency in front of them
+    // and their distance from the camera
+    void update(const float* densities, int count, float transparency, float distance);
+
+private:
+    AdaptiveSettings settings_;
+    float fixed_step_;
+    float extinction_coeff_;
+    float step_;
+    float previous_density_{-1.0f};
+};
+
+} // namespace march
+
+#endif // MARCH_HPP
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+#include <SFML/Graphics/Image.hpp>
+
+#include "output.hpp"
+
+namespace output
+{
+
+namespace
+{
+
+void write_floats(std::ofstream& stream, const float* values, std::size_t count)
+{
+    static_assert(std::endian::native == std::endian::little, "Float outputs are written little-endian");
+    stream.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(float)));
+}
+
+std::ofstream open_output(const std::string& filename)
+{
+    std::ofstream stream{filename, std::ios::binary};
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to open " + filename};
+    }
+    return stream;
+}
+
+void write_png(const std::vector<float>& rgb, const sf::Vector2u& size, const std::string& filename,
+               render::ToneMapping tone_mapping, float exposure)
+{
+    const std::size_t pixel_count{static_cast<std::size_t>(size.x) * size.y};
+    std::vector<std::uint8_t> rgba(pixel_count * 4);
+    for (std::size_t pixel = 0; pixel < pixel_count; ++pixel)
+    {
+        rgba[4 * pixel + 0] = render::tone_map(rgb[3 * pixel + 0], tone_mapping, exposure);
+        rgba[4 * pixel + 1] = render::tone_map(rgb[3 * pixel + 1], tone_mapping, exposure);
+        rgba[4 * pixel + 2] = render::tone_map(rgb[3 * pixel + 2], tone_mapping, exposure);
+        rgba[4 * pixel + 3] = 255;
+    }
+
+    sf::Image image{};
+    image.create(size.x, size.y, rgba.data());
+    if (!image.saveToFile(filename))
+    {
+        throw std::runtime_error{"Failed to write " + filename};
+    }
+}
+
+void write_raw(const std::vector<float>& rgb, const std::string& filename)
+{
+    std::ofstream stream{open_output(filename)};
+    write_floats(stream, rgb.data(), rgb.size());
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to write " + filename};
+    }
+}
+
+void write_pfm(const std::vector<float>& rgb, const sf::Vector2u& size, const std::string& filename)
+{
+    std::ofstream stream{open_output(filename)};
+    // A negative scale marks little-endian data
+    stream << "PF\n" << size.x << ' ' << size.y << "\n-1.0\n";
+    for (std::uint32_t row = size.y; row-- > 0;)
+    {
+        write_floats(stream, rgb.data() + static_cast<std::size_t>(row) * size.x * 3,
+                     static_cast<std::size_t>(size.x) * 3);
+    }
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to write " + filename};
+    }
+}
+
+} // namespace
+
+ImageFormat format_from_extension(const std::string& filename)
+{
+    const std::size_t dot{filename.find_last_of('.')};
+    std::string extension{dot == std::string::npos ? std::string{} : filename.substr(dot + 1)};
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+    if (extension == "pfm")
+    {
+        return ImageFormat::Pfm;
+    }
+    if (extension == "raw" || extension == "bin")
+    {
+        return ImageFormat::RawFloat;
+    }
+    return ImageFormat::Png;
+}
+
+OutputQueue::OutputQueue(std::size_t pool_size) :
+    pool_size_{std::max<std::size_t>(pool_size, 1)}, free_buffers_(pool_size_), worker_{[this] { write_images(); }}
+{
+}
+
+OutputQueue::~OutputQueue()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    queue_changed_.notify_all();
+    worker_.join();
+
+    if (error_)
+    {
+        try
+        {
+            std::rethrow_exception(error_);
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << '\n';
+        }
+    }
+}
+
+void OutputQueue::enqueue(const render::FrameBuffer& framebuffer, const OutputSettings& settings,
+                          std::string filename)
+{
+    std::unique_lock lock{mutex_};
+    queue_changed_.wait(lock, [this] { return !free_buffers_.empty(); });
+    std::vector<float> rgb{std::move(free_buffers_.back())};
+    free_buffers_.pop_back();
+    lock.unlock();
+
+    // Copying the means is the only work done on the rendering thread
+    framebuffer.means(rgb);
+    const ImageFormat format{settings.format.value_or(format_from_extension(filename))};
+    Job job{.rgb = std::move(rgb),
+            .size = framebuffer.size(),
+            .filename = std::move(filename),
+            .format = format,
+            .tone_mapping = settings.tone_mapping,
+            .exposure = settings.exposure};
+
+    lock.lock();
+    pending_.push_back(std::move(job));
+    lock.unlock();
+    queue_changed_.notify_all();
+}
+
+void OutputQueue::flush()
+{
+    std::unique_lock lock{mutex_};
+    queue_changed_.wait(lock, [this] { return free_buffers_.size() == pool_size_; });
+    if (error_)
+    {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void OutputQueue::write_images()
+{
+    while (true)
+    {
+        std::unique_lock lock{mutex_};
+        queue_changed_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty())
+        {
+            return;
+        }
+
+        Job job{std::move(pending_.front())};
+        pending_.pop_front();
+        lock.unlock();
+
+        std::exception_ptr error{};
+        try
+        {
+            switch (job.format)
+            {
+            case ImageFormat::Png:
+                write_png(job.rgb, job.size, job.filename, job.tone_mapping, job.exposure);
+                break;
+            case ImageFormat::RawFloat:
+                write_raw(job.rgb, job.filename);
+                break;
+            case ImageFormat::Pfm:
+                write_pfm(job.rgb, job.size, job.filename);
+                break;
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (!error_)
+        {
+            error_ = error;
+        }
+        free_buffers_.push_back(std::move(job.rgb));
+        lock.unlock();
+        queue_changed_.notify_all();
+    }
+}
+
+} // namespace output
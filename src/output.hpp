@@ -0,0 +1,93 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SFML/System/Vector2.hpp>
+
+#include "framebuffer.hpp"
+
+namespace output
+{
+
+enum class ImageFormat
+{
+    // Tone mapped 8-bit image; SFML picks PNG, BMP, TGA or JPEG from the extension
+    Png,
+    // Headerless rows of little-endian RGB floats, top row first
+    RawFloat,
+    // Portable float map: HDR RGB floats, bottom row first
+    Pfm
+};
+
+// .pfm is Pfm, .raw and .bin are RawFloat, anything else is Png
+ImageFormat format_from_extension(const std::string& filename);
+
+struct OutputSettings
+{
+    bool enabled{true};
+    // Empty writes to the default name of the rendered scene
+    std::string path{};
+    // Deduced from the path's extension when empty
+    std::optional<ImageFormat> format{};
+    render::ToneMapping tone_mapping{render::ToneMapping::Clamp};
+    float exposure{1.0f};
+};
+
+/*
+
+Encodes and writes images on a background thread. enqueue only copies the framebuffer's
+means into one of pool_size reusable float buffers, so a render never waits on encoding
+or disk unless pool_size images are already pending. The first write error is kept and
+rethrown by flush; one that flush never reported is printed to stderr on destruction.
+
+*/
+
+class OutputQueue
+{
+public:
+    explicit OutputQueue(std::size_t pool_size = 3);
+    // Writes all pending images before returning
+    ~OutputQueue();
+
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+
+    void enqueue(const render::FrameBuffer& framebuffer, const OutputSettings& settings, std::string filename);
+    // Blocks until every queued image is written; throws the first error of a failed write
+    void flush();
+
+private:
+    struct Job
+    {
+        std::vector<float> rgb;
+        sf::Vector2u size;
+        std::string filename;
+        ImageFormat format;
+        render::ToneMapping tone_mapping;
+        float exposure;
+    };
+
+    const std::size_t pool_size_;
+    std::vector<std::vector<float>> free_buffers_;
+    std::deque<Job> pending_;
+    bool stopping_{false};
+    std::exception_ptr error_{};
+    std::mutex mutex_;
+    std::condition_variable queue_changed_;
+    std::thread worker_;
+
+    void write_images();
+};
+
+} // namespace output
+
+#endif // OUTPUT_HPP
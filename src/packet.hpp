@@ -0,0 +1,80 @@
+#ifndef PACKET_HPP
+#define PACKET_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace packet
+{
+
+/*
+
+Structure-of-arrays batches for the volume integrators. A ray's traversal (DDA with empty
+space skipping, or fixed steps) stays scalar, but the segments it produces are collected
+lanes at a time so that transmittance, shadow lookups and phase weighting run as
+fixed-width SIMD loops (#pragma omp simd) instead of one out-of-line call per segment.
+
+*/
+
+constexpr int lanes{8};
+
+// exp(x) to within 1e-7 relative error for x in [-5e6, 88]; results below exp(-87) flush to zero.
+// Written without branches, library calls or float comparisons so that it vectorizes:
+// x = n * ln(2) + r, exp(r) by a polynomial, 2^n built in the exponent bits
+#pragma omp declare simd
+inline float fast_exp(float x)
+{
+    // Adding and subtracting 1.5 * 2^23 rounds to the nearest integer
+    const float n{(x * 1.44269504f + 12582912.0f) - 12582912.0f};
+    // ln(2) split in two so r keeps full precision
+    const float r{x - n * 0.693359375f + n * 2.12194440e-4f};
+    float p{1.9875691500e-4f};
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    const std::int32_t exponent{std::max(static_cast<std::int32_t>(n) + 127, 0)};
+    return p * std::bit_cast<float>(exponent << 23);
+}
+
+// Up to lanes segments of one ray: constant density over a length, plus the point at
+// which the light reaching the segment is estimated. Lanes past size hold stale values,
+// so fixed-width loops may process them but their results must be ignored.
+struct SegmentBatch
+{
+    alignas(32) float density[lanes]{};
+    alignas(32) float length[lanes]{};
+    alignas(32) float x[lanes]{};
+    alignas(32) float y[lanes]{};
+    alignas(32) float z[lanes]{};
+    int size{0};
+
+    void push(float segment_density, float segment_length, const glm::vec3& light_point)
+    {
+        density[size] = segment_density;
+        length[size] = segment_length;
+        x[size] = light_point.x;
+        y[size] = light_point.y;
+        z[size] = light_point.z;
+        ++size;
+    }
+
+    bool full() const
+    {
+        return size == lanes;
+    }
+
+    void clear()
+    {
+        size = 0;
+    }
+};
+
+} // namespace packet
+
+#endif // PACKET_HPP
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <array>
+
+#include "perlin.hpp"
+#include "random_gen.hpp"
+#include "util.hpp"
+
+namespace perlin
+{
+
+namespace
+{
+
+// Lattice hash constants of libnoise
+constexpr std::uint32_t x_noise_gen{1619};
+constexpr std::uint32_t y_noise_gen{31337};
+constexpr std::uint32_t z_noise_gen{6971};
+constexpr std::uint32_t seed_noise_gen{1013};
+constexpr std::uint32_t shift_noise_gen{8};
+// Scales gradient noise to roughly [-1, 1]
+constexpr float gradient_scale{2.12f};
+
+struct GradientTable
+{
+    alignas(64) std::array<float, 256> x;
+    alignas(64) std::array<float, 256> y;
+    alignas(64) std::array<float, 256> z;
+};
+
+// Unit vectors distributed uniformly over the sphere, from a fixed random stream
+GradientTable make_gradients()
+{
+    GradientTable table{};
+    randomgen::Generator generator{0x6772616469656e74ull};
+    for (std::size_t index = 0; index < 256; ++index)
+    {
+        glm::vec3 direction{};
+        do
+        {
+            direction = glm::vec3{generator.random_float(-1.0f, 1.0f), generator.random_float(-1.0f, 1.0f),
+                                  generator.random_float(-1.0f, 1.0f)};
+        } while (glm::dot(direction, direction) > 1.0f || glm::dot(direction, direction) < 1e-4f);
+        direction = glm::normalize(direction);
+        table.x[index] = direction.x;
+        table.y[index] = direction.y;
+        table.z[index] = direction.z;
+    }
+    return table;
+}
+
+const GradientTable gradients{make_gradients()};
+
+// Dot product of the pseudo-random gradient at lattice point (ix, iy, iz) with the offset to (x, y, z)
+inline float lattice_gradient(float x, float y, float z, int ix, int iy, int iz, std::uint32_t seed)
+{
+    std::uint32_t index{x_noise_gen * static_cast<std::uint32_t>(ix) + y_noise_gen * static_cast<std::uint32_t>(iy) +
+                        z_noise_gen * static_cast<std::uint32_t>(iz) + seed_noise_gen * seed};
+    index ^= index >> shift_noise_gen;
+    index &= 0xff;
+    return (gradients.x[index] * (x - static_cast<float>(ix)) + gradients.y[index] * (y - static_cast<float>(iy)) +
+            gradients.z[index] * (z - static_cast<float>(iz))) *
+           gradient_scale;
+}
+
+// floor as an integer, comparing instead of branching so that it vectorizes
+inline int floor_to_int(float value)
+{
+    const int truncated{static_cast<int>(value)};
+    return truncated - static_cast<int>(value < static_cast<float>(truncated));
+}
+
+inline float s_curve(float t)
+{
+    return t * t * (3.0f - 2.0f * t);
+}
+
+inline float lerp(float a, float b, float t)
+{
+    return a + t * (b - a);
+}
+
+#pragma omp declare simd uniform(seed) notinbranch
+float gradient_noise(float x, float y, float z, std::uint32_t seed)
+{
+    const int x0{floor_to_int(x)};
+    const int y0{floor_to_int(y)};
+    const int z0{floor_to_int(z)};
+    const float sx{s_curve(x - static_cast<float>(x0))};
+    const float sy{s_curve(y - static_cast<float>(y0))};
+    const float sz{s_curve(z - static_cast<float>(z0))};
+
+    const float n00{lerp(lattice_gradient(x, y, z, x0, y0, z0, seed), lattice_gradient(x, y, z, x0 + 1, y0, z0, seed),
+                         sx)};
+    const float n10{lerp(lattice_gradient(x, y, z, x0, y0 + 1, z0, seed),
+                         lattice_gradient(x, y, z, x0 + 1, y0 + 1, z0, seed), sx)};
+    const float n01{lerp(lattice_gradient(x, y, z, x0, y0, z0 + 1, seed),
+                         lattice_gradient(x, y, z, x0 + 1, y0, z0 + 1, seed), sx)};
+    const float n11{lerp(lattice_gradient(x, y, z, x0, y0 + 1, z0 + 1, seed),
+                         lattice_gradient(x, y, z, x0 + 1, y0 + 1, z0 + 1, seed), sx)};
+    return lerp(lerp(n00, n10, sy), lerp(n01, n11, sy), sz);
+}
+
+} // namespace
+
+std::uint64_t parameters_hash(const FbmParameters& parameters)
+{
+    std::uint64_t hash{util::hash_bytes(&parameters.frequency, sizeof(parameters.frequency))};
+    hash = util::hash_bytes(&parameters.octaves, sizeof(parameters.octaves), hash);
+    hash = util::hash_bytes(&parameters.lacunarity, sizeof(parameters.lacunarity), hash);
+    hash = util::hash_bytes(&parameters.persistence, sizeof(parameters.persistence), hash);
+    return util::hash_bytes(&parameters.seed, sizeof(parameters.seed), hash);
+}
+
+Fbm::Fbm(const FbmParameters& parameters) : parameters_{parameters}
+{
+}
+
+const FbmParameters& Fbm::parameters() const
+{
+    return parameters_;
+}
+
+float Fbm::operator()(const glm::vec3& position) const
+{
+    float value{0.0f};
+    evaluate(&position.x, &position.y, &position.z, &value, 1);
+    return value;
+}
+
+void Fbm::evaluate(const float* x, const float* y, const float* z, float* values, int count) const
+{
+    for (int first = 0; first < count; first += lanes)
+    {
+        const int size{std::min(lanes, count - first)};
+        alignas(32) float px[lanes]{};
+        alignas(32) float py[lanes]{};
+        alignas(32) float pz[lanes]{};
+        alignas(32) float sum[lanes]{};
+        for (int lane = 0; lane < size; ++lane)
+        {
+            px[lane] = x[first + lane] * parameters_.frequency;
+            py[lane] = y[first + lane] * parameters_.frequency;
+            pz[lane] = z[first + lane] * parameters_.frequency;
+        }
+
+        float amplitude{1.0f};
+        for (int octave = 0; octave < parameters_.octaves; ++octave)
+        {
+            const std::uint32_t seed{static_cast<std::uint32_t>(parameters_.seed + octave)};
+#pragma omp simd
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                sum[lane] += amplitude * gradient_noise(px[lane], py[lane], pz[lane], seed);
+                px[lane] *= parameters_.lacunarity;
+                py[lane] *= parameters_.lacunarity;
+                pz[lane] *= parameters_.lacunarity;
+            }
+            amplitude *= parameters_.persistence;
+        }
+        std::copy_n(sum, size, values + first);
+    }
+}
+
+} // namespace perlin
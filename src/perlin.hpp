@@ -0,0 +1,58 @@
+#ifndef PERLIN_HPP
+#define PERLIN_HPP
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace perlin
+{
+
+struct FbmParameters
+{
+    float frequency{0.5f};
+    int octaves{6};
+    float lacunarity{2.0f};
+    float persistence{0.5f};
+    int seed{0};
+
+    bool operator==(const FbmParameters&) const = default;
+};
+
+// Stable across runs; keys caches of data derived from the noise
+std::uint64_t parameters_hash(const FbmParameters& parameters);
+
+/*
+
+Fractal Brownian motion over 3D gradient (Perlin) noise, in float.
+
+Follows libnoise's Perlin module at standard quality: octave o samples gradient noise with
+seed + o at frequency * lacunarity^o, weighted by persistence^o, and lattice gradients
+are picked by the same integer hash and scaled by the same factor, so the output has the
+same range and character. The 256 gradient vectors are generated in-house, so values
+differ point by point from libnoise.
+
+Parameters are fixed at construction, so one Fbm can be shared by any number of threads.
+evaluate processes positions lanes at a time with vectorized loops.
+
+*/
+
+class Fbm
+{
+public:
+    static constexpr int lanes{8};
+
+    explicit Fbm(const FbmParameters& parameters = {});
+
+    const FbmParameters& parameters() const;
+    float operator()(const glm::vec3& position) const;
+    // Noise at count positions given as coordinate arrays
+    void evaluate(const float* x, const float* y, const float* z, float* values, int count) const;
+
+private:
+    FbmParameters parameters_;
+};
+
+} // namespace perlin
+
+#endif // PERLIN_HPP
@@ -1,13 +1,30 @@
 #ifndef PHASE_HPP
 #define PHASE_HPP
 
+#include <cmath>
+
 namespace phase
 {
 
+constexpr float pi()
+{
+    return 3.141592653589793238462643383279502884f;
+}
+
 // g: asymmetry factor
 // cos_theta: cosine of the angle between light direction and view direction
-float henyey_greenstein(float g, float cos_theta);
+inline float henyey_greenstein(float g, float cos_theta)
+{
+    const float base_denominator{1 + (g * g) - (2 * g * cos_theta)};
+    return (1.0f / (4.0f * pi())) * ((1 - (g * g)) / (base_denominator * std::sqrt(base_denominator)));
+}
+
+// Scatters equally in every direction
+constexpr float isotropic()
+{
+    return 1.0f / (4.0f * pi());
+}
 
 } // namespace phase
 
-#endif // PHASE_HPP
\ No newline at end of file
+#endif // PHASE_HPP
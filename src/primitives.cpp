@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <atomic>
+#include <utility>
 
+#include "grid_file.hpp"
 #include "primitives.hpp"
 #include "ray.hpp"
 
@@ -84,4 +87,52 @@ bool Box::intersect(const geometry::Ray& ray, HitRecord& record) const
     return true;
 }
 
+void Box::set_density(grid::SparseGrid values)
+{
+    density = std::move(values);
+    grid_resolution = density.resolution();
+    update_density_derived();
+}
+
+void Box::load_density(const std::string& filename)
+{
+    if (filename.ends_with(grid::grid_file_extension))
+    {
+        const grid::GridFile file{grid::load_grid_file(filename)};
+        bounds = file.bounds;
+        set_density(file.channel("density"));
+    }
+    else
+    {
+        set_density(grid::SparseGrid::read_raw(filename, grid_resolution));
+    }
+}
+
+std::uint64_t Box::density_revision() const
+{
+    return density_revision_;
+}
+
+void Box::set_filter(sampler::Filter filter)
+{
+    if (filter != filter_)
+    {
+        filter_ = filter;
+        update_density_derived();
+    }
+}
+
+sampler::Filter Box::filter() const
+{
+    return filter_;
+}
+
+void Box::update_density_derived()
+{
+    // Revisions are unique across boxes, so a box replaced by another one is never mistaken for it
+    static std::atomic<std::uint64_t> next_revision{1};
+    majorants.build(density, sampler::footprint(filter_));
+    density_revision_ = next_revision.fetch_add(1, std::memory_order_relaxed);
+}
+
 } // namespace primitives
\ No newline at end of file
@@ -2,11 +2,16 @@
 #define PRIMITIVES_HPP
 
 #include <array>
-#include <vector>
+#include <cstdint>
+#include <string>
 
 #include <SFML/System/Vector3.hpp>
 #include <glm/glm.hpp>
 
+#include "majorant.hpp"
+#include "sampler.hpp"
+#include "sparse_grid.hpp"
+
 // Forward declaration
 namespace geometry
 {
@@ -47,11 +52,28 @@ struct Box : public Geometry
 {
     bool intersect(const geometry::Ray& ray, HitRecord& record) const override;
 
+    // Replace the density grid and rebuild its majorants; data derived from the density is keyed on the revision.
+    // grid_resolution is taken from the grid.
+    void set_density(grid::SparseGrid values);
+    // Loads a .vgrid file (memory-mapped, with its bounds) or a raw float cache of grid_resolution^3 voxels
+    void load_density(const std::string& filename);
+    std::uint64_t density_revision() const;
+    // Reconstruction filter of density lookups; changing it rebuilds the majorants and counts as a new density
+    void set_filter(sampler::Filter filter);
+    sampler::Filter filter() const;
+
     std::array<glm::vec3, 2> bounds{glm::vec3{-50.0f, -50.0f, -50.0f}, glm::vec3{50.0f, 50.0f, 50.0f}};
     float absorption_coeff{0.5f};
     float scattering_coeff{0.5f};
     int grid_resolution{128};
-    std::vector<float> density;
+    grid::SparseGrid density;
+    majorant::MajorantGrid majorants;
+
+private:
+    std::uint64_t density_revision_{0};
+    sampler::Filter filter_{sampler::Filter::Nearest};
+
+    void update_density_derived();
 };
 
 using Grid = Box;
@@ -0,0 +1,98 @@
+#include "progressive.hpp"
+#include "context.hpp"
+#include "stats.hpp"
+
+namespace render
+{
+
+ProgressiveRenderer::ProgressiveRenderer(Context& context, std::uint32_t max_passes, std::uint32_t preview_stride) :
+    context_{context}, max_passes_{max_passes}, preview_stride_{preview_stride}
+{
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+    // Join before the members the render thread uses are destroyed
+    worker_ = {};
+}
+
+void ProgressiveRenderer::restart(RenderPass render_pass)
+{
+    // Assigning a jthread requests a stop on the running render and joins it
+    worker_ = {};
+    worker_ = std::jthread{[this, render_pass = std::move(render_pass)](std::stop_token stop)
+                           {
+                               render_passes(render_pass, stop);
+                           }};
+}
+
+bool ProgressiveRenderer::take_image(sf::Image& image)
+{
+    std::lock_guard lock{mutex_};
+    if (!has_new_image_)
+    {
+        return false;
+    }
+    image = published_;
+    has_new_image_ = false;
+    return true;
+}
+
+bool ProgressiveRenderer::take_heatmap(sf::Image& heatmap)
+{
+    std::lock_guard lock{mutex_};
+    if (!has_new_heatmap_)
+    {
+        return false;
+    }
+    heatmap = published_heatmap_;
+    has_new_heatmap_ = false;
+    return true;
+}
+
+std::uint32_t ProgressiveRenderer::published_samples() const
+{
+    return published_samples_.load(std::memory_order_relaxed);
+}
+
+void ProgressiveRenderer::render_passes(const RenderPass& render_pass, std::stop_token stop)
+{
+    context_.set_accumulate(true);
+    context_.reset_accumulation();
+    if (preview_stride_ > 1)
+    {
+        context_.set_pixel_stride(preview_stride_);
+        const bool completed{render_pass(context_, stop)};
+        context_.set_pixel_stride(1);
+        if (!completed)
+        {
+            return;
+        }
+        publish();
+    }
+
+    for (std::uint32_t pass = 0; pass < max_passes_; ++pass)
+    {
+        if (!render_pass(context_, stop))
+        {
+            return;
+        }
+        publish();
+    }
+}
+
+void ProgressiveRenderer::publish()
+{
+    std::lock_guard lock{mutex_};
+    published_ = context_.image();
+    has_new_image_ = true;
+    if constexpr (stats::enabled)
+    {
+        // Translucent so the render stays visible under the overlay
+        published_heatmap_ = context_.cost_heatmap(stats::HeatmapMetric::Time, 160);
+        has_new_heatmap_ = true;
+    }
+    published_samples_.store(context_.accumulated_samples(), std::memory_order_relaxed);
+}
+
+} // namespace render
@@ -0,0 +1,71 @@
+#ifndef PROGRESSIVE_HPP
+#define PROGRESSIVE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+#include <SFML/Graphics/Image.hpp>
+
+namespace render
+{
+
+class Context;
+
+/*
+
+Renders on a background thread so an interactive viewer never blocks on the renderer.
+After each restart it renders a coarse preview, then accumulates one full-resolution
+pass after another into the context until max_passes is reached. The viewer polls
+take_image once per frame to pick up the latest finished pass.
+
+While a render runs, the context and whatever render_pass uses belong to the render
+thread; restart and the destructor cancel it and wait for it before returning.
+
+*/
+
+class ProgressiveRenderer
+{
+public:
+    // Renders one pass into the context; returns false if it was cancelled
+    using RenderPass = std::function<bool(Context&, std::stop_token)>;
+
+    explicit ProgressiveRenderer(Context& context, std::uint32_t max_passes = 256, std::uint32_t preview_stride = 8);
+    ~ProgressiveRenderer();
+
+    ProgressiveRenderer(const ProgressiveRenderer&) = delete;
+    ProgressiveRenderer& operator=(const ProgressiveRenderer&) = delete;
+
+    // Cancels the current render and starts over; render_pass should capture scene
+    // parameters by value so the caller can keep editing its own copies
+    void restart(RenderPass render_pass);
+    // Copies the latest finished pass into image; returns false if nothing new was published
+    bool take_image(sf::Image& image);
+    // Copies the cost heatmap of the latest finished pass; returns false if there is none
+    // or it was taken already (always false in builds without VOLRENDER_STATS)
+    bool take_heatmap(sf::Image& heatmap);
+    // Samples per pixel in the latest published image (0 while only the preview is shown)
+    std::uint32_t published_samples() const;
+
+private:
+    Context& context_;
+    const std::uint32_t max_passes_;
+    const std::uint32_t preview_stride_;
+    std::mutex mutex_;
+    sf::Image published_{};
+    bool has_new_image_{false};
+    sf::Image published_heatmap_{};
+    bool has_new_heatmap_{false};
+    std::atomic<std::uint32_t> published_samples_{0};
+    std::jthread worker_;
+
+    void render_passes(const RenderPass& render_pass, std::stop_token stop);
+    void publish();
+};
+
+} // namespace render
+
+#endif // PROGRESSIVE_HPP
@@ -0,0 +1,56 @@
+#ifndef QUADRATURE_HPP
+#define QUADRATURE_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace quadrature
+{
+
+/*
+
+Gauss-Legendre quadrature for the smooth integrands of the analytic volume tracers.
+The 8-node rule is exact for polynomials up to degree 15; longer intervals are split into
+equal sub-intervals (composite rule) so that fast decaying exponentials stay accurate.
+
+*/
+
+// Positive half of the symmetric 8-node rule on [-1, 1]
+constexpr std::array<float, 4> nodes{0.1834346424956498f, 0.5255324099163290f, 0.7966664774136267f,
+                                     0.9602898564975363f};
+constexpr std::array<float, 4> weights{0.3626837833783620f, 0.3137066458778873f, 0.2223810344533745f,
+                                       0.1012285362903763f};
+
+constexpr int nodes_per_interval{2 * static_cast<int>(nodes.size())};
+
+// Calls visit(position, weight) for every node of the rule over [a, b] split into intervals equal parts, always in
+// the same order. The weights include the interval scaling: the integral is the weighted sum of the function values.
+template <typename Visit>
+void for_each_node(float a, float b, int intervals, const Visit& visit)
+{
+    const float interval_length{(b - a) / static_cast<float>(intervals)};
+    const float half_length{0.5f * interval_length};
+    for (int interval = 0; interval < intervals; ++interval)
+    {
+        const float midpoint{a + interval_length * (static_cast<float>(interval) + 0.5f)};
+        for (std::size_t node = 0; node < nodes.size(); ++node)
+        {
+            const float offset{half_length * nodes[node]};
+            visit(midpoint - offset, half_length * weights[node]);
+            visit(midpoint + offset, half_length * weights[node]);
+        }
+    }
+}
+
+// Integral of function over [a, b] split into intervals equal parts
+template <typename Function>
+float gauss_legendre(float a, float b, int intervals, const Function& function)
+{
+    float sum{0.0f};
+    for_each_node(a, b, intervals, [&](float position, float weight) { sum += weight * function(position); });
+    return sum;
+}
+
+} // namespace quadrature
+
+#endif // QUADRATURE_HPP
@@ -1,20 +1,56 @@
-#include <random>
-
 #include "random_gen.hpp"
 
 namespace randomgen
 {
 
-float random_float()
+namespace
 {
-    static std::default_random_engine generator;
-    static std::uniform_real_distribution<float> distribution{0.0, 1.0};
-    return distribution(generator);
+
+constexpr std::uint64_t pcg_multiplier{6364136223846793005ULL};
+
+// SplitMix64 finalizer, used to decorrelate neighbouring (stream, seed) pairs
+std::uint64_t mix(std::uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
 }
 
-float random_float(float min, float max)
+} // namespace
+
+Generator::Generator(std::uint64_t stream, std::uint64_t seed) : increment_{(mix(stream) << 1u) | 1u}
+{
+    next_uint();
+    state_ += mix(seed ^ mix(stream));
+    next_uint();
+}
+
+std::uint32_t Generator::next_uint()
+{
+    const std::uint64_t old_state{state_};
+    state_ = old_state * pcg_multiplier + increment_;
+    const auto xor_shifted{static_cast<std::uint32_t>(((old_state >> 18u) ^ old_state) >> 27u)};
+    const auto rotation{static_cast<std::uint32_t>(old_state >> 59u)};
+    return (xor_shifted >> rotation) | (xor_shifted << ((32u - rotation) & 31u));
+}
+
+float Generator::random_float()
+{
+    // Use the upper 24 bits so the result is exactly representable and always < 1
+    return static_cast<float>(next_uint() >> 8u) * 0x1.0p-24f;
+}
+
+float Generator::random_float(float min, float max)
 {
     return min + ((max - min) * random_float());
 }
 
-} // namespace randomgen
\ No newline at end of file
+Generator Generator::fork()
+{
+    const std::uint64_t high{next_uint()};
+    const std::uint64_t low{next_uint()};
+    return Generator{(high << 32u) | low, increment_};
+}
+
+} // namespace randomgen
@@ -1,12 +1,36 @@
 #ifndef RANDOM_HPP
 #define RANDOM_HPP
 
+#include <cstdint>
+
 namespace randomgen
 {
 
-float random_float();
-float random_float(float min, float max);
+/*
+
+PCG32 generator whose state is derived only from a (stream, seed) pair.
+The render loop creates one generator per pixel, using the pixel index as
+the stream and the frame number as the seed, so every pixel draws the same
+sequence regardless of which thread renders it or in which order.
+
+*/
+
+class Generator
+{
+public:
+    Generator(std::uint64_t stream, std::uint64_t seed = 0);
+
+    std::uint32_t next_uint();
+    float random_float();
+    float random_float(float min, float max);
+    // Generator of a separate sequence, derived from the next two numbers of this one
+    Generator fork();
+
+private:
+    std::uint64_t state_{0};
+    std::uint64_t increment_{0};
+};
 
 } // namespace randomgen
 
-#endif // RANDOM_HPP
\ No newline at end of file
+#endif // RANDOM_HPP
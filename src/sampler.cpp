@@ -0,0 +1,95 @@
+#include "sampler.hpp"
+#include "sparse_grid.hpp"
+
+namespace sampler
+{
+
+namespace
+{
+
+// Blends the 8 gathered voxels (x fastest) with the fractional position inside the block
+float blend(const float* values, const glm::vec3& weight)
+{
+    const float x00{values[0] + (weight.x * (values[1] - values[0]))};
+    const float x10{values[2] + (weight.x * (values[3] - values[2]))};
+    const float x01{values[4] + (weight.x * (values[5] - values[4]))};
+    const float x11{values[6] + (weight.x * (values[7] - values[6]))};
+    const float y0{x00 + (weight.y * (x10 - x00))};
+    const float y1{x01 + (weight.y * (x11 - x01))};
+    return y0 + (weight.z * (y1 - y0));
+}
+
+} // namespace
+
+int footprint(Filter filter)
+{
+    switch (filter)
+    {
+    case Filter::Trilinear:
+        return 1;
+    case Filter::Tricubic:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+float nearest(const grid::SparseGrid& grid, const glm::vec3& lattice_point)
+{
+    return grid.value(glm::ivec3{glm::floor(lattice_point)});
+}
+
+float trilinear(const grid::SparseGrid& grid, const glm::vec3& lattice_point)
+{
+    const glm::vec3 corner{glm::floor(lattice_point)};
+    float values[8];
+    grid.gather(glm::ivec3{corner}, values);
+    return blend(values, lattice_point - corner);
+}
+
+float tricubic(const grid::SparseGrid& grid, const glm::vec3& lattice_point)
+{
+    // Uniform cubic B-spline weights of the voxels at corner - 1 ... corner + 2
+    const glm::vec3 corner{glm::floor(lattice_point)};
+    const glm::vec3 t{lattice_point - corner};
+    const glm::vec3 t2{t * t};
+    const glm::vec3 t3{t2 * t};
+    const glm::vec3 w0{(1.0f - (3.0f * t) + (3.0f * t2) - t3) / 6.0f};
+    const glm::vec3 w1{(4.0f - (6.0f * t2) + (3.0f * t3)) / 6.0f};
+    const glm::vec3 w3{t3 / 6.0f};
+    const glm::vec3 w2{1.0f - w0 - w1 - w3};
+
+    // Pairs of voxels collapse into one linear lookup placed between them by their relative weight.
+    // The weights are positive, so the lookups never leave the [corner - 1, corner + 2] neighbourhood.
+    const glm::vec3 g0{w0 + w1};
+    const glm::vec3 g1{w2 + w3};
+    const glm::vec3 h0{corner - 1.0f + (w1 / g0)};
+    const glm::vec3 h1{corner + 1.0f + (w3 / g1)};
+
+    float result{0.0f};
+    for (int lookup = 0; lookup < 8; ++lookup)
+    {
+        const bool upper_x{(lookup & 1) != 0};
+        const bool upper_y{((lookup >> 1) & 1) != 0};
+        const bool upper_z{((lookup >> 2) & 1) != 0};
+        const glm::vec3 position{upper_x ? h1.x : h0.x, upper_y ? h1.y : h0.y, upper_z ? h1.z : h0.z};
+        const float weight{(upper_x ? g1.x : g0.x) * (upper_y ? g1.y : g0.y) * (upper_z ? g1.z : g0.z)};
+        result += weight * trilinear(grid, position);
+    }
+    return result;
+}
+
+float sample(const grid::SparseGrid& grid, const glm::vec3& lattice_point, Filter filter)
+{
+    switch (filter)
+    {
+    case Filter::Trilinear:
+        return trilinear(grid, lattice_point);
+    case Filter::Tricubic:
+        return tricubic(grid, lattice_point);
+    default:
+        return nearest(grid, lattice_point);
+    }
+}
+
+} // namespace sampler
@@ -0,0 +1,52 @@
+#ifndef SAMPLER_HPP
+#define SAMPLER_HPP
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// Forward declaration
+namespace grid
+{
+
+class SparseGrid;
+
+} // namespace grid
+
+namespace sampler
+{
+
+/*
+
+Reconstruction filters for voxel grid lookups.
+
+Lookups take lattice coordinates, where voxel i is centred on integer coordinate i. Nearest
+returns voxel floor(point), the voxel of the lattice cell the point lies in, so the density is
+constant inside the cells walked by traversal::walk_voxels. Trilinear blends the 2x2x2 voxels at
+the corners of the cell and tricubic applies a cubic B-spline to the 4x4x4 voxels around it,
+evaluated as 8 trilinear lookups with shifted positions and weights. Both fetch their voxels
+through grid::SparseGrid::gather, one brick lookup per 2x2x2 block.
+
+The smooth filters hide the voxel structure, so grids can be marched with steps of about a
+voxel instead of several samples per voxel.
+
+*/
+
+enum class Filter : std::uint8_t
+{
+    Nearest = 0,
+    Trilinear = 1,
+    Tricubic = 2,
+};
+
+// Number of voxels around a lattice cell that a lookup inside the cell may read
+int footprint(Filter filter);
+
+float nearest(const grid::SparseGrid& grid, const glm::vec3& lattice_point);
+float trilinear(const grid::SparseGrid& grid, const glm::vec3& lattice_point);
+float tricubic(const grid::SparseGrid& grid, const glm::vec3& lattice_point);
+float sample(const grid::SparseGrid& grid, const glm::vec3& lattice_point, Filter filter);
+
+} // namespace sampler
+
+#endif // SAMPLER_HPP
@@ -1,57 +1,178 @@
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
 
+#include "bake.hpp"
 #include "density.hpp"
+#include "march.hpp"
+#include "packet.hpp"
 #include "phase.hpp"
 #include "primitives.hpp"
+#include "quadrature.hpp"
 #include "random_gen.hpp"
 #include "ray.hpp"
 #include "scene_tracer.hpp"
+#include "stats.hpp"
+#include "traversal.hpp"
 #include "volume.hpp"
 
 namespace scene
 {
 
-sf::Vector3f VolumeAbsorption::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const
+namespace
 {
-    primitives::HitRecord record{};
-    const sf::Vector3f background{0.0f, 1.0f, 1.0f};
-    if (sphere.intersect(ray, record))
+
+// Steps of the chapter 2 and 3 marches, shortened to fit the segment evenly
+constexpr float in_scattering_step_size{0.2f};
+constexpr float complete_step_size{0.1f};
+
+// Number of quadrature intervals for an integrand whose exponent changes by up to optical_depth
+int quadrature_intervals(float optical_depth, float interval_optical_depth)
+{
+    if (interval_optical_depth <= 0.0f)
     {
-        const glm::vec3 first_hit{ray.evaluate(record.min_root)};
-        const glm::vec3 second_hit{ray.evaluate(record.max_root)};
-        const float distance{glm::length(second_hit - first_hit)};
-        const float transmittance{volume::beer_lambert_transmittance(distance, sphere.absorption_coeff)};
-        return volume::volume_scattering(transmittance, background, sphere.color);
+        return 1;
     }
+    return std::clamp(static_cast<int>(std::ceil(optical_depth / interval_optical_depth)), 1, 64);
+}
 
-    return background;
+// Calls trace with room for count floats, on the stack unless count is unusually large
+template <typename Trace>
+sf::Vector3f with_nodes(int count, const Trace& trace)
+{
+    constexpr int stack_nodes{128};
+    if (count <= stack_nodes)
+    {
+        std::array<float, stack_nodes> nodes;
+        return trace(nodes.data());
+    }
+    std::vector<float> nodes(static_cast<std::size_t>(count));
+    return trace(nodes.data());
 }
 
-sf::Vector3f VolumeInScattering::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const
+} // namespace
+
+std::unique_ptr<SceneTracer> make_tracer(Chapters chapter)
+{
+    switch (chapter)
+    {
+    case Chapters::VolumeAbsorption:
+        return std::make_unique<VolumeAbsorption>();
+    case Chapters::VolumeInScattering:
+        return std::make_unique<VolumeInScattering>();
+    case Chapters::VolumeComplete:
+        return std::make_unique<VolumeComplete>();
+    case Chapters::VolumeDensityField:
+        return std::make_unique<VolumeDensityField>();
+    case Chapters::VolumeVoxelGrid:
+        return std::make_unique<VolumeVoxelGrid>();
+    case Chapters::VolumeDeltaTracking:
+        return std::make_unique<VolumeDeltaTracking>();
+    case Chapters::VolumeSingleScattering:
+        return std::make_unique<VolumeSingleScattering>();
+    default:
+        throw std::invalid_argument{"Unknown chapter"};
+    }
+}
+
+Tracer make_tracer_variant(Chapters chapter)
+{
+    switch (chapter)
+    {
+    case Chapters::VolumeAbsorption:
+        return Tracer{std::in_place_type<VolumeAbsorption>};
+    case Chapters::VolumeInScattering:
+        return Tracer{std::in_place_type<VolumeInScattering>};
+    case Chapters::VolumeComplete:
+        return Tracer{std::in_place_type<VolumeComplete>};
+    case Chapters::VolumeDensityField:
+        return Tracer{std::in_place_type<VolumeDensityField>};
+    case Chapters::VolumeVoxelGrid:
+        return Tracer{std::in_place_type<VolumeVoxelGrid>};
+    case Chapters::VolumeDeltaTracking:
+        return Tracer{std::in_place_type<VolumeDeltaTracking>};
+    case Chapters::VolumeSingleScattering:
+        return Tracer{std::in_place_type<VolumeSingleScattering>};
+    default:
+        throw std::invalid_argument{"Unknown chapter"};
+    }
+}
+
+sf::Vector3f VolumeAbsorption::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                          randomgen::Generator& generator) const
+{
+    return shade(ray, sphere, ray_geometry(ray, sphere, nullptr, generator), nullptr, generator);
+}
+
+GeometryKey VolumeAbsorption::geometry_key(const primitives::Sphere& sphere) const
+{
+    return GeometryKey{.chapter = Chapters::VolumeAbsorption, .center = sphere.center, .radius = sphere.radius};
+}
+
+float VolumeAbsorption::ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* /*nodes*/,
+                                     randomgen::Generator& /*generator*/) const
 {
     primitives::HitRecord record{};
-    const sf::Vector3f background{0.572f, 0.772f, 0.921f};
     if (!sphere.intersect(ray, record))
+    {
+        return 0.0f;
+    }
+
+    const glm::vec3 first_hit{ray.evaluate(record.min_root)};
+    const glm::vec3 second_hit{ray.evaluate(record.max_root)};
+    return glm::length(second_hit - first_hit);
+}
+
+sf::Vector3f VolumeAbsorption::shade(const geometry::Ray& /*ray*/, const primitives::Sphere& sphere, float length,
+                                     const float* /*nodes*/, randomgen::Generator& /*generator*/) const
+{
+    const sf::Vector3f background{0.0f, 1.0f, 1.0f};
+    if (length <= 0.0f)
     {
         return background;
     }
 
-    float step_size{0.2f};
-    const int number_of_steps{static_cast<int>(std::ceil((record.max_root - record.min_root) / step_size))};
-    step_size = (record.max_root - record.min_root) / number_of_steps;
+    const float transmittance{volume::beer_lambert_transmittance(length, sphere.absorption_coeff)};
+    return volume::volume_scattering(transmittance, background, sphere.color);
+}
 
-    float transparency{1.0f};
-    glm::vec3 final_color{0.0f, 0.0f, 0.0f};
-    // For uniform ray-marching, the sample attenuation is assumed to be constant
-    const float attenuation{volume::beer_lambert_transmittance(step_size, sphere.absorption_coeff)};
+sf::Vector3f VolumeInScattering::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                            randomgen::Generator& generator) const
+{
+    return with_nodes(geometry_key(sphere).nodes, [&](float* nodes)
+                      { return shade(ray, sphere, ray_geometry(ray, sphere, nodes, generator), nodes, generator); });
+}
+
+GeometryKey VolumeInScattering::geometry_key(const primitives::Sphere& sphere) const
+{
+    // One step more than a diameter takes, in case rounding lengthens the segment
+    const int max_steps{static_cast<int>(std::ceil(2.0f * sphere.radius / in_scattering_step_size)) + 1};
+    return GeometryKey{.chapter = Chapters::VolumeInScattering,
+                       .center = sphere.center,
+                       .radius = sphere.radius,
+                       .light_direction = light_direction,
+                       .nodes = max_steps};
+}
+
+float VolumeInScattering::ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                                       randomgen::Generator& /*generator*/) const
+{
+    primitives::HitRecord record{};
+    if (!sphere.intersect(ray, record))
+    {
+        return 0.0f;
+    }
+
+    const float length{record.max_root - record.min_root};
+    const int number_of_steps{static_cast<int>(std::ceil(length / in_scattering_step_size))};
+    const float step_size{length / number_of_steps};
     for (int step = 0; step < number_of_steps; ++step)
     {
         float current_step_parameter{record.min_root + (step_size * (step + 0.5f))};
         const glm::vec3 sample_position{ray.evaluate(current_step_parameter)};
-        transparency *= attenuation;
         const geometry::Ray in_scattering_ray{.origin = sample_position, .direction = light_direction};
         primitives::HitRecord volume_hit{.inside = false};
 
@@ -59,20 +180,7 @@ sf::Vector3f VolumeInScattering::operator()(const geometry::Ray& ray, const prim
         // in the position where the ray entered the volume
         if (sphere.intersect(in_scattering_ray, volume_hit) && volume_hit.inside)
         {
-            const float light_attenuation{
-                volume::beer_lambert_transmittance(volume_hit.max_root, sphere.absorption_coeff)};
-            const glm::vec3 in_scattering_contribution{light_attenuation * light_color}; // L_i(x)
-
-            // Integration (Riemman Sum) of the sample
-            final_color += (transparency * step_size * sphere.absorption_coeff) * in_scattering_contribution;
-            /*
-            NOTE: sphere.absorption_coeff on the equation/code above actually should be sphere.scattering_coefficient
-            which wasn't presented on Chapter 2. Without the scattering term, a white sphere appears.
-            I modified the original author's code and remove the scattering term, and it also resulted on a
-            white sphere.
-            I used sphere.absorption_coeff for simplicity (since the default values of absorption and scattering are
-            equal) and to get a decent output, but the true term should be scattering, not absorption.
-            */
+            nodes[step] = volume_hit.max_root;
         }
         else
         {
@@ -80,58 +188,140 @@ sf::Vector3f VolumeInScattering::operator()(const geometry::Ray& ray, const prim
         }
     }
 
-    return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
+    stats::count(stats::Counter::LightSteps, static_cast<std::uint64_t>(number_of_steps));
+    return length;
 }
 
-sf::Vector3f VolumeComplete::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const
+sf::Vector3f VolumeInScattering::shade(const geometry::Ray& /*ray*/, const primitives::Sphere& sphere, float length,
+                                       const float* nodes, randomgen::Generator& /*generator*/) const
 {
-    primitives::HitRecord record;
     const sf::Vector3f background{0.572f, 0.772f, 0.921f};
-    if (!sphere.intersect(ray, record))
+    if (length <= 0.0f)
     {
         return background;
     }
 
-    float step_size{0.1f};
-    const int number_of_steps{static_cast<int>(std::ceil((record.max_root - record.min_root) / step_size))};
-    step_size = (record.max_root - record.min_root) / number_of_steps;
-
-    glm::vec3 final_color{0.0f, 0.0f, 0.0f};
+    const int number_of_steps{static_cast<int>(std::ceil(length / in_scattering_step_size))};
+    const float step_size{length / number_of_steps};
     float transparency{1.0f};
-    const float attenuation{volume::beer_lambert_transmittance(
-        step_size, sphere.density * (sphere.absorption_coeff + sphere.scattering_coeff))};
+    glm::vec3 final_color{0.0f, 0.0f, 0.0f};
+    // For uniform ray-marching, the sample attenuation is assumed to be constant
+    const float attenuation{volume::beer_lambert_transmittance(step_size, sphere.absorption_coeff)};
+    stats::count(stats::Counter::MarchSteps, static_cast<std::uint64_t>(number_of_steps));
+    for (int step = 0; step < number_of_steps; ++step)
+    {
+        transparency *= attenuation;
+        const float light_attenuation{volume::beer_lambert_transmittance(nodes[step], sphere.absorption_coeff)};
+        const glm::vec3 in_scattering_contribution{light_attenuation * light_color}; // L_i(x)
+
+        // Integration (Riemman Sum) of the sample
+        final_color += (transparency * step_size * sphere.absorption_coeff) * in_scattering_contribution;
+        /*
+        NOTE: sphere.absorption_coeff on the equation/code above actually should be sphere.scattering_coefficient
+        which wasn't presented on Chapter 2. Without the scattering term, a white sphere appears.
+        I modified the original author's code and remove the scattering term, and it also resulted on a
+        white sphere.
+        I used sphere.absorption_coeff for simplicity (since the default values of absorption and scattering are
+        equal) and to get a decent output, but the true term should be scattering, not absorption.
+        */
+    }
+
+    return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
+}
+
+sf::Vector3f VolumeComplete::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                        randomgen::Generator& generator) const
+{
+    randomgen::Generator geometry_generator{generator.fork()};
+    return with_nodes(geometry_key(sphere).nodes,
+                      [&](float* nodes)
+                      {
+                          return shade(ray, sphere, ray_geometry(ray, sphere, nodes, geometry_generator), nodes,
+                                       generator);
+                      });
+}
+
+GeometryKey VolumeComplete::geometry_key(const primitives::Sphere& sphere) const
+{
+    // One step more than a diameter takes, in case rounding lengthens the segment
+    const int max_steps{static_cast<int>(std::ceil(2.0f * sphere.radius / complete_step_size)) + 1};
+    return GeometryKey{.chapter = Chapters::VolumeComplete,
+                       .center = sphere.center,
+                       .radius = sphere.radius,
+                       .light_direction = light_direction,
+                       .nodes = max_steps};
+}
+
+float VolumeComplete::ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                                   randomgen::Generator& generator) const
+{
+    primitives::HitRecord record;
+    if (!sphere.intersect(ray, record))
+    {
+        return 0.0f;
+    }
+
+    const float length{record.max_root - record.min_root};
+    const int number_of_steps{static_cast<int>(std::ceil(length / complete_step_size))};
+    const float step_size{length / number_of_steps};
     for (int step = 0; step < number_of_steps; ++step)
     {
         // NOTE: when step = 0 and random_float returns a float close to zero,
         // the in-scattering ray doesn't intersect the sphere; the same hapens
         // when step = number_of_steps - 1 and random float returns a value that is close to 1.
-        float jitter{randomgen::random_float(0.01f, 0.95f)};
+        float jitter{generator.random_float(0.01f, 0.95f)};
         const float parameter{record.min_root + step_size * (step + jitter)};
-        // const float parameter{record.min_root + step_size * (step + 0.5f)};
         const glm::vec3 sample_position{ray.evaluate(parameter)};
-        transparency *= attenuation;
 
         const geometry::Ray in_scattering_ray{.origin = sample_position, .direction = light_direction};
         primitives::HitRecord volume_hit;
         if (sphere.intersect(in_scattering_ray, volume_hit) && volume_hit.inside)
         {
-            const float light_attenuation{volume::beer_lambert_transmittance(
-                volume_hit.max_root, sphere.density * (sphere.absorption_coeff + sphere.scattering_coeff))};
-            const glm::vec3 in_scattering_contribution{light_attenuation * light_color};
-            const float cos_theta{glm::dot(ray.direction, light_direction)};
-            final_color += (phase::henyey_greenstein(assymetry_factor, cos_theta) * transparency * step_size *
-                            sphere.scattering_coeff * sphere.density) *
-                           in_scattering_contribution;
+            nodes[step] = volume_hit.max_root;
         }
         else
         {
             throw std::runtime_error("In-scattering ray didn't intersect sphere");
         }
+    }
+
+    stats::count(stats::Counter::LightSteps, static_cast<std::uint64_t>(number_of_steps));
+    return length;
+}
+
+sf::Vector3f VolumeComplete::shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length,
+                                   const float* nodes, randomgen::Generator& generator) const
+{
+    const sf::Vector3f background{0.572f, 0.772f, 0.921f};
+    if (length <= 0.0f)
+    {
+        return background;
+    }
+
+    const int number_of_steps{static_cast<int>(std::ceil(length / complete_step_size))};
+    const float step_size{length / number_of_steps};
+
+    glm::vec3 final_color{0.0f, 0.0f, 0.0f};
+    float transparency{1.0f};
+    const float extinction_coeff{sphere.density * (sphere.absorption_coeff + sphere.scattering_coeff)};
+    const float attenuation{volume::beer_lambert_transmittance(step_size, extinction_coeff)};
+    const float cos_theta{glm::dot(ray.direction, light_direction)};
+    const float phase_value{phase::henyey_greenstein(assymetry_factor, cos_theta)};
+    for (int step = 0; step < number_of_steps; ++step)
+    {
+        stats::count(stats::Counter::MarchSteps);
+        transparency *= attenuation;
+
+        const float light_attenuation{volume::beer_lambert_transmittance(nodes[step], extinction_coeff)};
+        const glm::vec3 in_scattering_contribution{light_attenuation * light_color};
+        final_color += (phase_value * transparency * step_size * sphere.scattering_coeff * sphere.density) *
+                       in_scattering_contribution;
 
         if (transparency < 1e-3)
         {
-            if (randomgen::random_float() > russian_roulette)
+            if (generator.random_float() > russian_roulette)
             {
+                stats::count(stats::Counter::RouletteTerminations);
                 break;
             }
             else
@@ -144,7 +334,64 @@ sf::Vector3f VolumeComplete::operator()(const geometry::Ray& ray, const primitiv
     return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
 }
 
-sf::Vector3f VolumeDensityField::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const
+template <typename Policy>
+void BasicVolumeDensityField<Policy>::prepare(const primitives::Sphere& sphere)
+{
+    if (noise_.parameters() != fbm)
+    {
+        noise_ = perlin::Fbm{fbm};
+    }
+
+    if (baked_density)
+    {
+        const std::string filename{bake::fbm_cache_filename(bake_cache_directory, sphere, baked_resolution, fbm)};
+        if (filename != baked_filename_)
+        {
+            bake::load_or_bake_fbm(baked_, sphere, baked_resolution, fbm, bake_cache_directory);
+            baked_filename_ = filename;
+        }
+        baked_.set_filter(baked_filter);
+    }
+
+    if (precomputed_light)
+    {
+        if (baked_density)
+        {
+            light_volume_.update(baked_, light_direction);
+        }
+        else
+        {
+            light_volume_.update(sphere, light_direction, light_volume_resolution, noise_);
+        }
+    }
+}
+
+template <typename Policy>
+float BasicVolumeDensityField<Policy>::sample_density(const glm::vec3& position, const primitives::Sphere& sphere) const
+{
+    return baked_density ? density::eval_grid(position, baked_)
+                         : density::eval_fbm(position, sphere.center, sphere.radius, noise_);
+}
+
+template <typename Policy>
+void BasicVolumeDensityField<Policy>::sample_densities(const float* x, const float* y, const float* z,
+                                                       float* densities, int count,
+                                                       const primitives::Sphere& sphere) const
+{
+    if (!baked_density)
+    {
+        density::eval_fbm(x, y, z, densities, count, sphere.center, sphere.radius, noise_);
+        return;
+    }
+    for (int index = 0; index < count; ++index)
+    {
+        densities[index] = density::eval_grid(glm::vec3{x[index], y[index], z[index]}, baked_);
+    }
+}
+
+template <typename Policy>
+sf::Vector3f BasicVolumeDensityField<Policy>::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                                         randomgen::Generator& generator) const
 {
     primitives::HitRecord record;
     if (!sphere.intersect(ray, record))
@@ -152,63 +399,189 @@ sf::Vector3f VolumeDensityField::operator()(const geometry::Ray& ray, const prim
         return background;
     }
 
-    float step_size{0.1f};
+    float step_size{max_step_size};
     const int number_of_steps{static_cast<int>(std::ceil((record.max_root - record.min_root) / step_size))};
     step_size = (record.max_root - record.min_root) / number_of_steps;
 
     glm::vec3 final_color{0.0f, 0.0f, 0.0f};
     float transparency{1.0f};
     const float extinction_coeff{sphere.absorption_coeff + sphere.scattering_coeff};
-    for (int step = 0; step < number_of_steps; ++step)
-    {
-        const float jitter{randomgen::random_float(0.01f, 0.95f)};
-        const float parameter{record.min_root + step_size * (step + jitter)};
-        const glm::vec3 sample_position{ray.evaluate(parameter)};
-
-        const float density{density::eval_fbm(sample_position, sphere.center, sphere.radius)};
-        const float attenuation{volume::beer_lambert_transmittance(step_size, density * extinction_coeff)};
-        transparency *= attenuation;
+    const float cos_theta{glm::dot(-ray.direction, light_direction)};
+    const float phase_value{Policy::phase::evaluate(assymetry_factor, cos_theta)};
 
-        const geometry::Ray in_scattering_ray{.origin = sample_position, .direction = light_direction};
-        primitives::HitRecord volume_hit;
+    // Steps are integrated packet::lanes at a time; returns false once Russian roulette ends the ray
+    packet::SegmentBatch batch;
+    const auto integrate_batch = [&]
+    {
+        alignas(32) float light_depth[packet::lanes]{};
+        light_optical_depths(batch, sphere, light_step_size, light_depth);
+        alignas(32) float attenuation[packet::lanes];
+        alignas(32) float in_scattering[packet::lanes];
+#pragma omp simd
+        for (int lane = 0; lane < packet::lanes; ++lane)
+        {
+            attenuation[lane] = packet::fast_exp(-batch.length[lane] * batch.density[lane] * extinction_coeff);
+            in_scattering[lane] = packet::fast_exp(-light_depth[lane] * extinction_coeff) * phase_value *
+                                  sphere.scattering_coeff * batch.length[lane] * batch.density[lane];
+        }
 
-        // Compute density along in-scattering light ray passing through heterogeneous volume using ray marching
-        if (density > 0.0f && sphere.intersect(in_scattering_ray, volume_hit) && volume_hit.inside)
+        const int size{batch.size};
+        batch.clear();
+        for (int lane = 0; lane < size; ++lane)
         {
-            const int light_steps{static_cast<int>(std::ceil(volume_hit.max_root / step_size))};
-            const float light_step_size{volume_hit.max_root / light_steps};
-            float optical_depth{0.0f};
-            for (int light_step = 0; light_step < light_steps; ++light_step)
+            transparency *= attenuation[lane];
+            final_color += light_color * (in_scattering[lane] * transparency);
+            if constexpr (Policy::russian_roulette)
             {
-                const float light_parameter{light_step_size * (light_step + 0.5f)};
-                const glm::vec3 light_sample_position{sample_position + (light_direction * light_parameter)};
-                optical_depth += density::eval_fbm(light_sample_position, sphere.center, sphere.radius);
+                if (transparency < 1e-3)
+                {
+                    if (generator.random_float() > russian_roulette)
+                    {
+                        stats::count(stats::Counter::RouletteTerminations);
+                        return false;
+                    }
+                    transparency /= russian_roulette;
+                }
             }
-            const float light_ray_attenuation{
-                volume::beer_lambert_transmittance(light_step_size, optical_depth * extinction_coeff)};
-            const glm::vec3 in_scattering_contribution{light_color * light_ray_attenuation};
-            const float cos_theta{glm::dot(-ray.direction, light_direction)};
-            final_color += in_scattering_contribution * phase::henyey_greenstein(assymetry_factor, cos_theta) *
-                           sphere.scattering_coeff * transparency * step_size * density;
         }
+        return true;
+    };
 
-        if (transparency < 1e-3)
+    // Densities are looked up packet::lanes steps at a time, so the noise evaluates as one vector batch.
+    // Adaptive steps change length between batches, using the densities of the batch before.
+    march::StepController steps{adaptive_step, step_size, extinction_coeff};
+    // Fixed steps are counted and placed from the entry point, so accumulated rounding can't add a short last step
+    const bool adaptive{adaptive_step.tolerance > 0.0f};
+    const float end_tolerance{1e-4f * step_size};
+    float segment_start{record.min_root};
+    int samples{0};
+    const auto steps_remain = [&](int taken)
+    { return adaptive ? record.max_root - segment_start > end_tolerance : taken < number_of_steps; };
+    bool alive{true};
+    while (alive && steps_remain(samples))
+    {
+        const float length{steps.step()};
+        alignas(32) float sample_x[packet::lanes];
+        alignas(32) float sample_y[packet::lanes];
+        alignas(32) float sample_z[packet::lanes];
+        alignas(32) float densities[packet::lanes];
+        float lengths[packet::lanes];
+        int count{0};
+        for (; count < packet::lanes && steps_remain(samples + count); ++count)
         {
-            if (randomgen::random_float() > russian_roulette)
+            const float jitter{Policy::jitter ? generator.random_float(0.01f, 0.95f) : 0.5f};
+            float parameter{};
+            if (adaptive)
             {
-                break;
+                lengths[count] = std::min(length, record.max_root - segment_start);
+                parameter = segment_start + (lengths[count] * jitter);
+                segment_start += lengths[count];
             }
             else
             {
-                transparency /= russian_roulette;
+                const int step_index{samples + count};
+                lengths[count] = step_size;
+                parameter = record.min_root + (step_size * (static_cast<float>(step_index) + jitter));
+                segment_start = record.min_root + (step_size * static_cast<float>(step_index + 1));
+            }
+            const glm::vec3 sample_position{ray.evaluate(parameter)};
+            sample_x[count] = sample_position.x;
+            sample_y[count] = sample_position.y;
+            sample_z[count] = sample_position.z;
+        }
+        sample_densities(sample_x, sample_y, sample_z, densities, count, sphere);
+        samples += count;
+        steps.update(densities, count, transparency, segment_start);
+
+        for (int step = 0; step < count; ++step)
+        {
+            // Empty samples neither attenuate nor scatter
+            if (densities[step] <= 0.0f)
+            {
+                continue;
+            }
+            batch.push(densities[step], lengths[step], glm::vec3{sample_x[step], sample_y[step], sample_z[step]});
+            if (batch.full() && !integrate_batch())
+            {
+                alive = false;
+                break;
             }
         }
     }
+    if (alive && batch.size > 0)
+    {
+        integrate_batch();
+    }
+
+    if (adaptive_step.tolerance > 0.0f)
+    {
+        stats::count(stats::Counter::AdaptiveSamples, static_cast<std::uint64_t>(samples));
+        stats::count(stats::Counter::FixedStepSamples,
+                     static_cast<std::uint64_t>(std::lround((segment_start - record.min_root) / step_size)));
+    }
+    stats::count(stats::Counter::MarchSteps, static_cast<std::uint64_t>(samples));
 
     return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
 }
 
-sf::Vector3f VolumeVoxelGrid::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const
+template <typename Policy>
+void BasicVolumeDensityField<Policy>::light_optical_depths(const packet::SegmentBatch& batch,
+                                                           const primitives::Sphere& sphere, float step_size,
+                                                           float* depths) const
+{
+    if (precomputed_light)
+    {
+        light_volume_.optical_depth(batch.x, batch.y, batch.z, depths, packet::lanes);
+        return;
+    }
+    for (int lane = 0; lane < batch.size; ++lane)
+    {
+        depths[lane] = light_optical_depth(glm::vec3{batch.x[lane], batch.y[lane], batch.z[lane]}, sphere, step_size);
+    }
+}
+
+template <typename Policy>
+float BasicVolumeDensityField<Policy>::light_optical_depth(const glm::vec3& position, const primitives::Sphere& sphere,
+                                                           float step_size) const
+{
+    if (precomputed_light)
+    {
+        return light_volume_.optical_depth(position);
+    }
+
+    // Reference path: compute density along in-scattering light ray using ray marching
+    const geometry::Ray in_scattering_ray{.origin = position, .direction = light_direction};
+    primitives::HitRecord volume_hit;
+    if (!sphere.intersect(in_scattering_ray, volume_hit) || !volume_hit.inside)
+    {
+        return 0.0f;
+    }
+
+    const int light_steps{static_cast<int>(std::ceil(volume_hit.max_root / step_size))};
+    const float light_step_size{volume_hit.max_root / light_steps};
+    stats::count(stats::Counter::LightSteps, static_cast<std::uint64_t>(light_steps));
+    float optical_depth{0.0f};
+    for (int light_step = 0; light_step < light_steps; ++light_step)
+    {
+        const float light_parameter{light_step_size * (light_step + 0.5f)};
+        const glm::vec3 light_sample_position{position + (light_direction * light_parameter)};
+        optical_depth += sample_density(light_sample_position, sphere);
+    }
+    return light_step_size * optical_depth;
+}
+
+template <typename Policy>
+void BasicVolumeVoxelGrid<Policy>::prepare(const primitives::Box& box)
+{
+    if (precomputed_light)
+    {
+        light_volume_.update(box, light_direction);
+    }
+}
+
+template <typename Policy>
+sf::Vector3f BasicVolumeVoxelGrid<Policy>::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                                      randomgen::Generator& /*generator*/) const
 {
     primitives::HitRecord record;
     if (!sphere.intersect(ray, record))
@@ -219,7 +592,9 @@ sf::Vector3f VolumeVoxelGrid::operator()(const geometry::Ray& ray, const primiti
     return sf::Vector3f{1.0f, 0.0f, 0.0f};
 }
 
-sf::Vector3f VolumeVoxelGrid::operator()(const geometry::Ray& ray, const primitives::Box& box) const
+template <typename Policy>
+sf::Vector3f BasicVolumeVoxelGrid<Policy>::operator()(const geometry::Ray& ray, const primitives::Box& box,
+                                                      randomgen::Generator& generator) const
 {
     primitives::HitRecord record;
     if (!box.intersect(ray, record))
@@ -227,61 +602,465 @@ sf::Vector3f VolumeVoxelGrid::operator()(const geometry::Ray& ray, const primiti
         return background;
     }
 
-    float step_size{0.1f};
-    const int number_of_steps{static_cast<int>(std::ceil((record.max_root - record.min_root) / step_size))};
-    step_size = (record.max_root - record.min_root) / number_of_steps;
-
     glm::vec3 final_color{0.0f, 0.0f, 0.0f};
     float transparency{1.0f};
     const float extinction_coeff{box.absorption_coeff + box.scattering_coeff};
-    for (int step = 0; step < number_of_steps; ++step)
+    const float albedo{extinction_coeff > 0.0f ? box.scattering_coeff / extinction_coeff : 0.0f};
+    const float cos_theta{glm::dot(-ray.direction, light_direction)};
+    const float phase_value{Policy::phase::evaluate(assymetry_factor, cos_theta)};
+
+    // With nearest lookups the density is constant inside each voxel, so transmittance across the voxel segment is
+    // exact and the in-scattering integral reduces to albedo * (1 - attenuation) for the light arriving inside the
+    // segment. Filtered grids use the same estimate with the density at the jittered sample position.
+    const bool nearest{box.filter() == sampler::Filter::Nearest};
+    // Occupied voxel segments are integrated packet::lanes at a time; returns false once Russian roulette
+    // ends the ray.
+    packet::SegmentBatch batch;
+    const auto integrate_batch = [&]
     {
-        const float jitter{randomgen::random_float(0.01f, 0.95f)};
-        const float parameter{record.min_root + step_size * (step + jitter)};
-        const glm::vec3 sample_position{ray.evaluate(parameter)};
+        alignas(32) float light_depth[packet::lanes]{};
+        light_optical_depths(batch, box, light_depth);
+        alignas(32) float attenuation[packet::lanes];
+        alignas(32) float in_scattering[packet::lanes];
+#pragma omp simd
+        for (int lane = 0; lane < packet::lanes; ++lane)
+        {
+            attenuation[lane] = packet::fast_exp(-batch.length[lane] * batch.density[lane] * extinction_coeff);
+            in_scattering[lane] = packet::fast_exp(-light_depth[lane] * extinction_coeff) * phase_value * albedo *
+                                  (1.0f - attenuation[lane]);
+        }
 
-        const float density{density::eval_grid(sample_position, box)};
-        const float attenuation{volume::beer_lambert_transmittance(step_size, density * extinction_coeff)};
-        transparency *= attenuation;
+        const int size{batch.size};
+        batch.clear();
+        for (int lane = 0; lane < size; ++lane)
+        {
+            final_color += light_color * (in_scattering[lane] * transparency);
+            transparency *= attenuation[lane];
+            if constexpr (Policy::russian_roulette)
+            {
+                if (transparency < 1e-3)
+                {
+                    if (generator.random_float() > russian_roulette)
+                    {
+                        stats::count(stats::Counter::RouletteTerminations);
+                        return false;
+                    }
+                    transparency /= russian_roulette;
+                }
+            }
+        }
+        return true;
+    };
 
-        geometry::Ray in_scattering_ray{.origin = sample_position, .direction = light_direction};
-        in_scattering_ray.compute_inv_direction();
-        primitives::HitRecord volume_hit;
+    // Bricks of empty voxels are skipped entirely
+    const bool finished{traversal::walk_occupied_voxels(
+        ray, box, std::max(record.min_root, 0.0f), record.max_root,
+        [&](const glm::ivec3& voxel, float t_enter, float t_exit)
+        {
+            stats::count(stats::Counter::MarchSteps);
+            // Nearest lookups know the density before the sample position is drawn, so empty voxels cost neither a
+            // random number nor a position
+            float density{nearest ? density::eval_voxel(voxel, box) : 0.0f};
+            if (nearest && density <= 0.0f)
+            {
+                return true;
+            }
+
+            // Light arriving in the segment is estimated at a jittered position, where filtered grids also take
+            // their density sample
+            const float segment_length{t_exit - t_enter};
+            const float offset{Policy::jitter ? generator.random_float() : 0.5f};
+            const glm::vec3 sample_position{ray.evaluate(t_enter + (segment_length * offset))};
+            if (!nearest)
+            {
+                density = density::eval_grid(sample_position, box);
+                if (density <= 0.0f)
+                {
+                    return true;
+                }
+            }
+
+            batch.push(density, segment_length, sample_position);
+            return !batch.full() || integrate_batch();
+        })};
+    if (finished && batch.size > 0)
+    {
+        integrate_batch();
+    }
+
+    return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
+}
+
+template <typename Policy>
+void BasicVolumeVoxelGrid<Policy>::light_optical_depths(const packet::SegmentBatch& batch, const primitives::Box& box,
+                                                        float* depths) const
+{
+    if (precomputed_light)
+    {
+        light_volume_.optical_depth(batch.x, batch.y, batch.z, depths, packet::lanes);
+        return;
+    }
+    for (int lane = 0; lane < batch.size; ++lane)
+    {
+        depths[lane] = light_optical_depth(glm::vec3{batch.x[lane], batch.y[lane], batch.z[lane]}, box);
+    }
+}
+
+template <typename Policy>
+float BasicVolumeVoxelGrid<Policy>::light_optical_depth(const glm::vec3& position, const primitives::Box& box) const
+{
+    if (precomputed_light)
+    {
+        return light_volume_.optical_depth(position);
+    }
+
+    // Reference path: integrate density exactly through the voxels crossed by the in-scattering light ray
+    geometry::Ray in_scattering_ray{.origin = position, .direction = light_direction};
+    in_scattering_ray.compute_inv_direction();
+    primitives::HitRecord volume_hit;
+    if (!box.intersect(in_scattering_ray, volume_hit) || volume_hit.max_root <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float optical_depth{0.0f};
+    traversal::walk_occupied_voxels(in_scattering_ray, box, 0.0f, volume_hit.max_root,
+                                    [&](const glm::ivec3& voxel, float t_enter, float t_exit)
+                                    {
+                                        stats::count(stats::Counter::LightSteps);
+                                        const float density{
+                                            box.filter() == sampler::Filter::Nearest
+                                                ? density::eval_voxel(voxel, box)
+                                                : density::eval_grid(
+                                                      in_scattering_ray.evaluate(0.5f * (t_enter + t_exit)), box)};
+                                        optical_depth += density * (t_exit - t_enter);
+                                        return true;
+                                    });
+    return optical_depth;
+}
+
+void VolumeDeltaTracking::prepare(const primitives::Sphere& sphere)
+{
+    const std::string filename{bake::fbm_cache_filename(bake_cache_directory, sphere, baked_resolution, fbm)};
+    if (filename != baked_filename_)
+    {
+        bake::load_or_bake_fbm(baked_, sphere, baked_resolution, fbm, bake_cache_directory);
+        baked_filename_ = filename;
+    }
+    baked_.set_filter(baked_filter);
+}
+
+sf::Vector3f VolumeDeltaTracking::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                             randomgen::Generator& generator) const
+{
+    primitives::HitRecord record;
+    if (!sphere.intersect(ray, record))
+    {
+        return background;
+    }
+
+    // The baked grid is zero outside of the sphere, so tracking only the sphere interval loses nothing
+    geometry::Ray grid_ray{ray};
+    grid_ray.compute_inv_direction();
+    return trace(grid_ray, baked_, std::max(record.min_root, 0.0f), record.max_root, sphere.absorption_coeff,
+                 sphere.scattering_coeff, generator);
+}
+
+sf::Vector3f VolumeDeltaTracking::operator()(const geometry::Ray& ray, const primitives::Box& box,
+                                             randomgen::Generator& generator) const
+{
+    primitives::HitRecord record;
+    if (!box.intersect(ray, record))
+    {
+        return background;
+    }
+
+    return trace(ray, box, std::max(record.min_root, 0.0f), record.max_root, box.absorption_coeff,
+                 box.scattering_coeff, generator);
+}
+
+sf::Vector3f VolumeDeltaTracking::trace(const geometry::Ray& ray, const primitives::Box& box, float t_min,
+                                        float t_max, float absorption_coeff, float scattering_coeff,
+                                        randomgen::Generator& generator) const
+{
+    const float extinction_coeff{absorption_coeff + scattering_coeff};
+    const float collision{sample_collision(ray, box, t_min, t_max, extinction_coeff, generator)};
+    if (collision >= t_max)
+    {
+        return background;
+    }
+
+    // Single scattering: the collision is weighted by the albedo instead of choosing between absorption and
+    // scattering, and the path ends there, as in the ray marching chapters
+    const float albedo{scattering_coeff / extinction_coeff};
+    const float cos_theta{glm::dot(-ray.direction, light_direction)};
+    const float phase_value{phase::henyey_greenstein(assymetry_factor, cos_theta)};
+    const float transmittance{light_transmittance(ray.evaluate(collision), box, extinction_coeff, generator)};
+    const glm::vec3 color{light_color * (albedo * phase_value * transmittance)};
+    return sf::Vector3f{color.x, color.y, color.z};
+}
 
-        // Compute density along in-scattering light ray passing through heterogeneous volume using ray marching
-        if (density > 0.0f && box.intersect(in_scattering_ray, volume_hit) && volume_hit.max_root > 0.0f)
+float VolumeDeltaTracking::sample_collision(const geometry::Ray& ray, const primitives::Box& box, float t_min,
+                                            float t_max, float extinction_coeff,
+                                            randomgen::Generator& generator) const
+{
+    if (extinction_coeff <= 0.0f)
+    {
+        return t_max;
+    }
+
+    // Tentative collisions are sampled against the majorant of each brick; sampling restarts at the brick exit,
+    // which is valid because the exponential distribution is memoryless
+    float collision{t_max};
+    traversal::walk_occupied_bricks(
+        ray, box, t_min, t_max,
+        [&](const glm::ivec3& brick, float t_enter, float t_exit)
         {
-            const int light_steps{static_cast<int>(std::ceil(volume_hit.max_root / step_size))};
-            const float light_step_size{volume_hit.max_root / light_steps};
-            float optical_depth{0.0f};
-            for (int light_step = 0; light_step < light_steps; ++light_step)
+            const float majorant{extinction_coeff * box.majorants.max_density(0, brick)};
+            float t{t_enter};
+            while (true)
             {
-                const float light_parameter{light_step_size * (light_step + 0.5f)};
-                const glm::vec3 light_sample_position{sample_position + (light_direction * light_parameter)};
-                optical_depth += density::eval_grid(light_sample_position, box);
+                t -= std::log(1.0f - generator.random_float()) / majorant;
+                if (t >= t_exit)
+                {
+                    return true;
+                }
+                stats::count(stats::Counter::MarchSteps);
+                // Real collision with probability density / majorant, otherwise a null collision
+                if (generator.random_float() * majorant < extinction_coeff * density::eval_grid(ray.evaluate(t), box))
+                {
+                    collision = t;
+                    return false;
+                }
             }
-            const float light_ray_attenuation{
-                volume::beer_lambert_transmittance(light_step_size, optical_depth * extinction_coeff)};
-            const glm::vec3 in_scattering_contribution{light_color * light_ray_attenuation};
-            const float cos_theta{glm::dot(-ray.direction, light_direction)};
-            final_color += in_scattering_contribution * phase::henyey_greenstein(assymetry_factor, cos_theta) *
-                           box.scattering_coeff * transparency * step_size * density;
+        });
+    return collision;
+}
+
+float VolumeDeltaTracking::light_transmittance(const glm::vec3& position, const primitives::Box& box,
+                                               float extinction_coeff, randomgen::Generator& generator) const
+{
+    geometry::Ray light_ray{.origin = position, .direction = light_direction};
+    light_ray.compute_inv_direction();
+    primitives::HitRecord volume_hit;
+    if (extinction_coeff <= 0.0f || !box.intersect(light_ray, volume_hit) || volume_hit.max_root <= 0.0f)
+    {
+        return 1.0f;
+    }
+
+    // Ratio tracking: every tentative collision scales the transmittance by its null-collision probability.
+    // Russian roulette ends the walk once the transmittance is too small to matter.
+    float transmittance{1.0f};
+    traversal::walk_occupied_bricks(
+        light_ray, box, 0.0f, volume_hit.max_root,
+        [&](const glm::ivec3& brick, float t_enter, float t_exit)
+        {
+            const float majorant{extinction_coeff * box.majorants.max_density(0, brick)};
+            float t{t_enter};
+            while (true)
+            {
+                t -= std::log(1.0f - generator.random_float()) / majorant;
+                if (t >= t_exit)
+                {
+                    return true;
+                }
+                stats::count(stats::Counter::LightSteps);
+                transmittance *= 1.0f - (extinction_coeff * density::eval_grid(light_ray.evaluate(t), box) / majorant);
+                if (transmittance < 1e-3f)
+                {
+                    if (generator.random_float() > russian_roulette)
+                    {
+                        stats::count(stats::Counter::RouletteTerminations);
+                        transmittance = 0.0f;
+                        return false;
+                    }
+                    transmittance /= russian_roulette;
+                }
+            }
+        });
+    return transmittance;
+}
+
+sf::Vector3f VolumeSingleScattering::operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                                randomgen::Generator& generator) const
+{
+    return with_nodes(geometry_key(sphere).nodes, [&](float* nodes)
+                      { return shade(ray, sphere, ray_geometry(ray, sphere, nodes, generator), nodes, generator); });
+}
+
+GeometryKey VolumeSingleScattering::geometry_key(const primitives::Sphere& sphere) const
+{
+    return GeometryKey{.chapter = Chapters::VolumeSingleScattering,
+                       .center = sphere.center,
+                       .radius = sphere.radius,
+                       .light_direction = light_direction,
+                       .nodes = std::max(sphere_intervals, 1) * quadrature::nodes_per_interval};
+}
+
+float VolumeSingleScattering::ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                                           randomgen::Generator& /*generator*/) const
+{
+    primitives::HitRecord record;
+    if (!sphere.intersect(ray, record))
+    {
+        return 0.0f;
+    }
+
+    const float length{record.max_root - record.min_root};
+    const glm::vec3 light{glm::normalize(light_direction)};
+
+    // The point at distance t past the entry is p = entry + t * direction (relative to the center); its light ray
+    // leaves the sphere at the far root of |p + s * light| = radius, s = sqrt(b^2 - c) - b.
+    // b and c are polynomials in t, so no intersection test is needed per node.
+    const glm::vec3 entry{ray.evaluate(record.min_root) - sphere.center};
+    const float entry_projection{glm::dot(entry, light)};
+    const float direction_projection{glm::dot(ray.direction, light)};
+    const float linear_coeff{2.0f * glm::dot(entry, ray.direction)};
+    const float quadratic_coeff{glm::dot(ray.direction, ray.direction)};
+    const float independent_coeff{glm::dot(entry, entry) - sphere.radius * sphere.radius};
+
+    // Where the light grazes the sphere at the entry or exit point, the light path length grows like sqrt(t) from
+    // there. Substituting t = length * (3s^2 - 2s^3) makes the integrand smooth at both ends of [0, 1].
+    const int intervals{std::max(sphere_intervals, 1)};
+    int node{0};
+    quadrature::for_each_node(0.0f, 1.0f, intervals,
+                              [&](float s, float /*weight*/)
+                              {
+                                  const float t{length * s * s * (3.0f - 2.0f * s)};
+                                  const float b{entry_projection + t * direction_projection};
+                                  const float c{independent_coeff + t * (linear_coeff + t * quadratic_coeff)};
+                                  const float light_distance{std::max(std::sqrt(std::max(b * b - c, 0.0f)) - b, 0.0f)};
+                                  nodes[node++] = t + light_distance;
+                              });
+    return length;
+}
+
+sf::Vector3f VolumeSingleScattering::shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length,
+                                           const float* nodes, randomgen::Generator& /*generator*/) const
+{
+    if (length <= 0.0f)
+    {
+        return background;
+    }
+
+    const float extinction_coeff{sphere.density * (sphere.absorption_coeff + sphere.scattering_coeff)};
+    const int intervals{std::max(sphere_intervals, 1)};
+    stats::count(stats::Counter::MarchSteps, static_cast<std::uint64_t>(intervals * quadrature::nodes_per_interval));
+    float integral{0.0f};
+    int node{0};
+    quadrature::for_each_node(0.0f, 1.0f, intervals,
+                              [&](float s, float weight)
+                              {
+                                  // dt/ds of the substitution times the transmittance along view and light path
+                                  integral += weight * 6.0f * length * s * (1.0f - s) *
+                                              std::exp(-extinction_coeff * nodes[node++]);
+                              });
+
+    const float cos_theta{glm::dot(ray.direction, light_direction)};
+    const glm::vec3 in_scattering{(phase::henyey_greenstein(assymetry_factor, cos_theta) * sphere.scattering_coeff *
+                                   sphere.density * integral) *
+                                  light_color};
+
+    return (background * volume::beer_lambert_transmittance(length, extinction_coeff)) +
+           sf::Vector3f{in_scattering.x, in_scattering.y, in_scattering.z};
+}
+
+sf::Vector3f VolumeSingleScattering::operator()(const geometry::Ray& ray, const primitives::Box& box,
+                                                randomgen::Generator& /*generator*/) const
+{
+    primitives::HitRecord record;
+    if (!box.intersect(ray, record))
+    {
+        return background;
+    }
+
+    const float t_min{std::max(record.min_root, 0.0f)};
+    const float t_max{record.max_root};
+    if (t_max <= t_min)
+    {
+        return background;
+    }
+
+    const float extinction_coeff{box.absorption_coeff + box.scattering_coeff};
+    const glm::vec3 light{glm::normalize(light_direction)};
+
+    // Along each axis the light ray from ray.evaluate(t) reaches the face it leaves through after a distance linear
+    // in t; the light path length is the smallest of them
+    std::array<float, 3> offsets{};
+    std::array<float, 3> slopes{};
+    int axes{0};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (light[axis] == 0.0f)
+        {
+            continue;
         }
+        const float face{box.bounds[light[axis] > 0.0f ? 1 : 0][axis]};
+        offsets[axes] = (face - ray.origin[axis]) / light[axis];
+        slopes[axes] = -ray.direction[axis] / light[axis];
+        ++axes;
+    }
+    const auto light_distance = [&](float t)
+    {
+        float distance{offsets[0] + slopes[0] * t};
+        for (int axis = 1; axis < axes; ++axis)
+        {
+            distance = std::min(distance, offsets[axis] + slopes[axis] * t);
+        }
+        return std::max(distance, 0.0f);
+    };
+    const auto transmittance = [&](float t)
+    {
+        return std::exp(-extinction_coeff * ((t - t_min) + light_distance(t)));
+    };
 
-        if (transparency < 1e-3)
+    // The nearest face changes where two axis distances cross. Between those points the integrand is a single
+    // exponential, which the quadrature integrates to float precision.
+    std::array<float, 5> pieces{t_min};
+    int piece_count{1};
+    for (int first = 0; first < axes; ++first)
+    {
+        for (int second = first + 1; second < axes; ++second)
         {
-            if (randomgen::random_float() > russian_roulette)
+            if (slopes[first] == slopes[second])
             {
-                break;
+                continue;
             }
-            else
+            const float t{(offsets[second] - offsets[first]) / (slopes[first] - slopes[second])};
+            if (t > t_min && t < t_max)
             {
-                transparency /= russian_roulette;
+                pieces[piece_count++] = t;
             }
         }
     }
+    pieces[piece_count++] = t_max;
+    std::sort(pieces.begin(), pieces.begin() + piece_count);
 
-    return (background * transparency) + sf::Vector3f{final_color.x, final_color.y, final_color.z};
+    float integral{0.0f};
+    for (int piece = 0; piece + 1 < piece_count; ++piece)
+    {
+        const float start{pieces[piece]};
+        const float end{pieces[piece + 1]};
+        const float depth_change{extinction_coeff *
+                                 std::abs((end - start) + light_distance(end) - light_distance(start))};
+        const int intervals{quadrature_intervals(depth_change, interval_optical_depth)};
+        stats::count(stats::Counter::MarchSteps,
+                     static_cast<std::uint64_t>(intervals * quadrature::nodes_per_interval));
+        integral += quadrature::gauss_legendre(start, end, intervals, transmittance);
+    }
+
+    // Same phase convention as the voxel grid tracer
+    const float cos_theta{glm::dot(-ray.direction, light_direction)};
+    const glm::vec3 in_scattering{
+        (phase::henyey_greenstein(assymetry_factor, cos_theta) * box.scattering_coeff * integral) * light_color};
+
+    return (background * volume::beer_lambert_transmittance(t_max - t_min, extinction_coeff)) +
+           sf::Vector3f{in_scattering.x, in_scattering.y, in_scattering.z};
 }
 
+template struct BasicVolumeDensityField<DefaultPolicy>;
+template struct BasicVolumeDensityField<DeterministicPolicy>;
+template struct BasicVolumeVoxelGrid<DefaultPolicy>;
+template struct BasicVolumeVoxelGrid<DeterministicPolicy>;
+
 } // namespace scene
\ No newline at end of file
@@ -1,9 +1,21 @@
 #ifndef SCENE_TRACER_HPP
 #define SCENE_TRACER_HPP
 
+#include <memory>
+#include <string>
+#include <variant>
+
 #include <SFML/System/Vector3.hpp>
 #include <glm/glm.hpp>
 
+#include "density.hpp"
+#include "march.hpp"
+#include "perlin.hpp"
+#include "phase.hpp"
+#include "primitives.hpp"
+#include "sampler.hpp"
+#include "shadow.hpp"
+
 // Forward declarations
 namespace geometry
 {
@@ -12,13 +24,19 @@ class Ray;
 
 } // namespace geometry
 
-namespace primitives
+namespace randomgen
+{
+
+class Generator;
+
+} // namespace randomgen
+
+namespace packet
 {
 
-class Box;
-class Sphere;
+struct SegmentBatch;
 
-} // namespace primitives
+} // namespace packet
 
 namespace scene
 {
@@ -26,49 +44,117 @@ namespace scene
 enum class Chapters
 {
     VolumeAbsorption = 0,
-    VolumeInScatteringBackward = 1,
-    NumberOfChapters = 2,
+    VolumeInScattering = 1,
+    VolumeComplete = 2,
+    VolumeDensityField = 3,
+    VolumeVoxelGrid = 4,
+    VolumeDeltaTracking = 5,
+    VolumeSingleScattering = 6,
+    NumberOfChapters = 7,
 };
 
 /*
 
 Functors implementing the topic of each chapter,
 one functor per chapter.
+Each call receives the random number generator of the pixel being traced;
+tracers must not hold or share random state between pixels.
+prepare is called once before each frame, outside the parallel region,
+so tracers can build per-frame data that the per-pixel calls only read.
 
 */
 
 struct SceneTracer
 {
     virtual ~SceneTracer() = default;
-    virtual sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const = 0;
-    virtual sf::Vector3f operator()(const geometry::Ray& /*ray*/, const primitives::Box& /*box*/) const
+    virtual void prepare(const primitives::Sphere& /*sphere*/)
+    {
+    }
+    virtual void prepare(const primitives::Box& /*box*/)
+    {
+    }
+    virtual sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                                    randomgen::Generator& generator) const = 0;
+    virtual sf::Vector3f operator()(const geometry::Ray& /*ray*/, const primitives::Box& /*box*/,
+                                    randomgen::Generator& /*generator*/) const
     {
         return sf::Vector3f{};
     }
 };
 
+/*
+
+Geometry caching (see render::Context). Tracers of homogeneous spheres split a sample in two:
+ray_geometry stores the distances that only depend on the ray, the sphere shape and the light
+direction, and shade turns them into a colour with the medium coefficients, colours and phase
+parameter. While geometry_key stays the same, stored geometry can be shaded again after any other edit.
+ray_geometry may draw random numbers (chapter 3 jitters its steps) from a generator forked from the
+pixel's one, which stays the same for a pixel and frame; shade draws from the pixel's generator.
+
+*/
+
+struct GeometryKey
+{
+    Chapters chapter{};
+    glm::vec3 center{};
+    float radius{0.0f};
+    glm::vec3 light_direction{};
+    // Floats ray_geometry stores per ray
+    int nodes{0};
+
+    bool operator==(const GeometryKey&) const = default;
+};
+
 // Chapter 1 - Ray Casting with Beer-Lambert Law, implementing Indirect Light Absorption
-struct VolumeAbsorption : public SceneTracer
+struct VolumeAbsorption final : public SceneTracer
 {
     ~VolumeAbsorption() override = default;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const override;
+    using SceneTracer::operator();
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+
+    GeometryKey geometry_key(const primitives::Sphere& sphere) const;
+    // Returns the length of the ray inside the sphere, 0 if it misses
+    float ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                       randomgen::Generator& generator) const;
+    sf::Vector3f shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length, const float* nodes,
+                       randomgen::Generator& generator) const;
 };
 
 // Chapter 2 - Ray Marching Algorithm, adding the contributions of Light In-Scattering
-struct VolumeInScattering : public SceneTracer
+struct VolumeInScattering final : public SceneTracer
 {
     ~VolumeInScattering() override = default;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const override;
+    using SceneTracer::operator();
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+
+    GeometryKey geometry_key(const primitives::Sphere& sphere) const;
+    // Stores the light path length at every step; returns the length of the ray inside the sphere, 0 if it misses
+    float ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                       randomgen::Generator& generator) const;
+    sf::Vector3f shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length, const float* nodes,
+                       randomgen::Generator& generator) const;
 
     glm::vec3 light_direction{0.0f, 1.0f, 0.0f};
     glm::vec3 light_color{1.3f, 0.3f, 0.9f};
 };
 
 // Chapter 3 - Ray Marching, now considering light in-Scattering, out-Scattering and absorption
-struct VolumeComplete : public SceneTracer
+struct VolumeComplete final : public SceneTracer
 {
     ~VolumeComplete() override = default;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const override;
+    using SceneTracer::operator();
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+
+    GeometryKey geometry_key(const primitives::Sphere& sphere) const;
+    // Stores the light path length at every jittered step; returns the length of the ray inside the sphere, 0 if it
+    // misses
+    float ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                       randomgen::Generator& generator) const;
+    sf::Vector3f shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length, const float* nodes,
+                       randomgen::Generator& generator) const;
 
     glm::vec3 light_direction{0.0f, 1.0f, 0.0f};
     glm::vec3 light_color{15.0f, 0.0f, 15.0f};
@@ -76,33 +162,217 @@ struct VolumeComplete : public SceneTracer
     float russian_roulette{0.5f};
 };
 
+/*
+
+Compile-time settings of the marching tracers (chapters 4 and 5). Every policy is a tracer type of
+its own, so the march loops are compiled without branches for the features it leaves out.
+Russian roulette ends rays whose transparency has become negligible; jitter places samples at
+random inside their steps instead of at fixed positions. Tracer templates are instantiated for
+the policies below in scene_tracer.cpp.
+
+*/
+
+struct HenyeyGreenstein
+{
+    static float evaluate(float asymmetry, float cos_theta)
+    {
+        return phase::henyey_greenstein(asymmetry, cos_theta);
+    }
+};
+
+struct Isotropic
+{
+    static float evaluate(float /*asymmetry*/, float /*cos_theta*/)
+    {
+        return phase::isotropic();
+    }
+};
+
+template <typename Phase, bool RussianRoulette, bool Jitter>
+struct MarchPolicy
+{
+    using phase = Phase;
+    static constexpr bool russian_roulette{RussianRoulette};
+    static constexpr bool jitter{Jitter};
+};
+
+using DefaultPolicy = MarchPolicy<HenyeyGreenstein, true, true>;
+// No random decisions along the ray, so images only vary with the pixel sample positions; headless selects it with
+// its deterministic setting
+using DeterministicPolicy = MarchPolicy<HenyeyGreenstein, false, false>;
+
 // Chapter 4 - 3D Density Field using procedural noise to create heterogeneous volumes
-struct VolumeDensityField : public SceneTracer
+template <typename Policy = DefaultPolicy>
+struct BasicVolumeDensityField final : public SceneTracer
 {
-    ~VolumeDensityField() override = default;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const override;
+    ~BasicVolumeDensityField() override = default;
+    using SceneTracer::operator();
+    using SceneTracer::prepare;
+    void prepare(const primitives::Sphere& sphere) override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
 
     const sf::Vector3f background{0.572f, 0.772f, 0.921f};
     glm::vec3 light_direction{-0.315798f, 0.719361f, 0.618702f};
     glm::vec3 light_color{20.0f, 20.0f, 20.0f};
     float assymetry_factor{0.0f};
     float russian_roulette{0.5f};
+    // Look up light transmittance in a precomputed shadow volume instead of marching towards the light
+    bool precomputed_light{true};
+    int light_volume_resolution{128};
+    perlin::FbmParameters fbm{};
+    // Upper bound of the fixed ray marching step; the steps are shortened to fit the segment evenly
+    float max_step_size{0.1f};
+    // Steps adapted to the density variation along the ray, off with the default zero tolerance
+    march::AdaptiveSettings adaptive_step{};
+    // Step of the light march when the light volume is not precomputed
+    float light_step_size{0.1f};
+    // Sample the noise baked into a grid (see bake.hpp) instead of evaluating it per sample
+    bool baked_density{true};
+    int baked_resolution{128};
+    sampler::Filter baked_filter{sampler::Filter::Trilinear};
+    std::string bake_cache_directory{"cachefiles"};
+
+private:
+    shadow::ShadowVolume light_volume_;
+    // Noise built from fbm in prepare(), shared read-only by the render threads
+    perlin::Fbm noise_;
+    primitives::Box baked_;
+    // Cache file of the grid in baked_, identifying the inputs it was baked from
+    std::string baked_filename_;
+
+    float sample_density(const glm::vec3& position, const primitives::Sphere& sphere) const;
+    // sample_density at count positions given as coordinate arrays
+    void sample_densities(const float* x, const float* y, const float* z, float* densities, int count,
+                          const primitives::Sphere& sphere) const;
+
+    float light_optical_depth(const glm::vec3& position, const primitives::Sphere& sphere, float step_size) const;
+    // Optical depths towards the light for the sample points of a batch
+    void light_optical_depths(const packet::SegmentBatch& batch, const primitives::Sphere& sphere, float step_size,
+                              float* depths) const;
 };
 
 // Chapter 5 - 3D Voxel Grid as Density Field, using cached fluid simulation to create heterogeneous volumes
-struct VolumeVoxelGrid : public SceneTracer
+// The grid is traversed voxel by voxel (3D-DDA) instead of in fixed steps
+template <typename Policy = DefaultPolicy>
+struct BasicVolumeVoxelGrid final : public SceneTracer
+{
+    ~BasicVolumeVoxelGrid() override = default;
+    using SceneTracer::prepare;
+    void prepare(const primitives::Box& box) override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Box& box,
+                            randomgen::Generator& generator) const override;
+
+    const sf::Vector3f background{0.572f, 0.772f, 0.921f};
+    glm::vec3 light_direction{-0.315798f, 0.719361f, 0.618702f};
+    glm::vec3 light_color{20.0f, 20.0f, 20.0f};
+    float assymetry_factor{0.0f};
+    float russian_roulette{0.5f};
+    // Look up light transmittance in a precomputed shadow volume instead of marching towards the light
+    bool precomputed_light{true};
+
+private:
+    shadow::ShadowVolume light_volume_;
+
+    float light_optical_depth(const glm::vec3& position, const primitives::Box& box) const;
+    void light_optical_depths(const packet::SegmentBatch& batch, const primitives::Box& box, float* depths) const;
+};
+
+using VolumeDensityField = BasicVolumeDensityField<>;
+using VolumeVoxelGrid = BasicVolumeVoxelGrid<>;
+
+/*
+
+Delta tracking - unbiased alternative to the ray marching chapters.
+The free-flight distance to the first real collision is sampled with Woodcock (delta) tracking
+against the brick majorants of the density grid, and the transmittance towards the light is
+estimated with ratio tracking. Empty bricks are skipped and sample counts scale with the
+optical thickness instead of the path length, so thin media take few density lookups.
+Voxel grids are tracked directly; the FBM sphere is tracked through its baked grid (see bake.hpp).
+
+*/
+struct VolumeDeltaTracking final : public SceneTracer
 {
-    ~VolumeVoxelGrid() override = default;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere) const override;
-    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Box& box) const override;
+    ~VolumeDeltaTracking() override = default;
+    using SceneTracer::prepare;
+    void prepare(const primitives::Sphere& sphere) override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Box& box,
+                            randomgen::Generator& generator) const override;
 
     const sf::Vector3f background{0.572f, 0.772f, 0.921f};
     glm::vec3 light_direction{-0.315798f, 0.719361f, 0.618702f};
     glm::vec3 light_color{20.0f, 20.0f, 20.0f};
     float assymetry_factor{0.0f};
     float russian_roulette{0.5f};
+    perlin::FbmParameters fbm{};
+    int baked_resolution{128};
+    sampler::Filter baked_filter{sampler::Filter::Trilinear};
+    std::string bake_cache_directory{"cachefiles"};
+
+private:
+    primitives::Box baked_;
+    // Cache file of the grid in baked_, identifying the inputs it was baked from
+    std::string baked_filename_;
+
+    sf::Vector3f trace(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max,
+                       float absorption_coeff, float scattering_coeff, randomgen::Generator& generator) const;
+    // Ray parameter of the first real collision in [t_min, t_max), or t_max if the ray passes through
+    float sample_collision(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max,
+                           float extinction_coeff, randomgen::Generator& generator) const;
+    float light_transmittance(const glm::vec3& position, const primitives::Box& box, float extinction_coeff,
+                              randomgen::Generator& generator) const;
 };
 
+/*
+
+Single scattering in homogeneous media without ray marching.
+Transmittance along the view ray and towards the light has a closed form in a homogeneous medium,
+so the in-scattering integral only needs the light path length at a few Gauss-Legendre nodes
+(see quadrature.hpp) instead of an intersection test and an exponential per step.
+Spheres use the medium of chapter 3 (VolumeComplete); boxes are taken as filled with unit density,
+matching a full voxel grid in chapter 5 (VolumeVoxelGrid), and their density grid is not read.
+
+*/
+struct VolumeSingleScattering final : public SceneTracer
+{
+    ~VolumeSingleScattering() override = default;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Sphere& sphere,
+                            randomgen::Generator& generator) const override;
+    sf::Vector3f operator()(const geometry::Ray& ray, const primitives::Box& box,
+                            randomgen::Generator& generator) const override;
+
+    GeometryKey geometry_key(const primitives::Sphere& sphere) const;
+    // Stores the view plus light path length at every quadrature node; returns the length of the ray inside the
+    // sphere, 0 if it misses
+    float ray_geometry(const geometry::Ray& ray, const primitives::Sphere& sphere, float* nodes,
+                       randomgen::Generator& generator) const;
+    sf::Vector3f shade(const geometry::Ray& ray, const primitives::Sphere& sphere, float length, const float* nodes,
+                       randomgen::Generator& generator) const;
+
+    const sf::Vector3f background{0.572f, 0.772f, 0.921f};
+    glm::vec3 light_direction{0.0f, 1.0f, 0.0f};
+    glm::vec3 light_color{15.0f, 0.0f, 15.0f};
+    float assymetry_factor{0.1f};
+    // Quadrature intervals along sphere rays. Fixed, so that the cached node positions only depend on the geometry;
+    // 4 intervals keep the integral within 1e-3 up to an optical depth of 20 across the sphere, denser media need more.
+    int sphere_intervals{4};
+    // Optical depth covered by each quadrature interval in boxes; denser media get more intervals
+    float interval_optical_depth{4.0f};
+};
+
+// Chapter tracers by value, indexed like Chapters. Renders through the variant dispatch once per frame
+// instead of once per sample (see render::Context::render_image).
+using Tracer = std::variant<VolumeAbsorption, VolumeInScattering, VolumeComplete, VolumeDensityField,
+                            VolumeVoxelGrid, VolumeDeltaTracking, VolumeSingleScattering>;
+
+// Creates the tracer implementing a chapter with its default settings
+std::unique_ptr<SceneTracer> make_tracer(Chapters chapter);
+Tracer make_tracer_variant(Chapters chapter);
+
 } // namespace scene
 
 #endif // SCENE_TRACER_HPP
\ No newline at end of file
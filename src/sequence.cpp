@@ -0,0 +1,88 @@
+#include <algorithm>
+
+#include "sequence.hpp"
+
+namespace sequence
+{
+
+std::string frame_filename(const std::string& pattern, int frame)
+{
+    std::string filename{pattern};
+    const std::size_t placeholder{filename.find("{}")};
+    if (placeholder != std::string::npos)
+    {
+        filename.replace(placeholder, 2, std::to_string(frame));
+    }
+    return filename;
+}
+
+FramePrefetcher::FramePrefetcher(int first_frame, int last_frame, std::size_t depth, Loader loader) :
+    last_frame_{last_frame}, depth_{std::max<std::size_t>(depth, 1)}, loader_{std::move(loader)},
+    next_to_consume_{first_frame}, worker_{[this, first_frame] { load_frames(first_frame); }}
+{
+}
+
+FramePrefetcher::~FramePrefetcher()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    ready_changed_.notify_all();
+    worker_.join();
+}
+
+std::optional<Frame> FramePrefetcher::next()
+{
+    if (next_to_consume_ > last_frame_)
+    {
+        return std::nullopt;
+    }
+
+    std::unique_lock lock{mutex_};
+    ready_changed_.wait(lock, [this] { return !ready_.empty(); });
+    Slot slot{std::move(ready_.front())};
+    ready_.pop_front();
+    lock.unlock();
+    ready_changed_.notify_all();
+
+    ++next_to_consume_;
+    if (slot.error)
+    {
+        std::rethrow_exception(slot.error);
+    }
+    return std::move(slot.frame);
+}
+
+void FramePrefetcher::load_frames(int first_frame)
+{
+    for (int frame = first_frame; frame <= last_frame_; ++frame)
+    {
+        {
+            std::unique_lock lock{mutex_};
+            ready_changed_.wait(lock, [this] { return stopping_ || ready_.size() < depth_; });
+            if (stopping_)
+            {
+                return;
+            }
+        }
+
+        Slot slot{};
+        try
+        {
+            slot.frame = Frame{.number = frame, .box = loader_(frame)};
+        }
+        catch (...)
+        {
+            slot.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock{mutex_};
+            ready_.push_back(std::move(slot));
+        }
+        ready_changed_.notify_all();
+    }
+}
+
+} // namespace sequence
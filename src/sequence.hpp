@@ -0,0 +1,72 @@
+#ifndef SEQUENCE_HPP
+#define SEQUENCE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "primitives.hpp"
+
+namespace sequence
+{
+
+// Replaces the first "{}" of pattern with the frame number, e.g. "cachefiles/grid.{}.bin"
+std::string frame_filename(const std::string& pattern, int frame);
+
+struct Frame
+{
+    int number{0};
+    primitives::Box box;
+};
+
+/*
+
+Loads the frames of a simulation sequence on a background thread, keeping up to
+depth decoded frames ready while the current one renders.
+
+*/
+
+class FramePrefetcher
+{
+public:
+    using Loader = std::function<primitives::Box(int frame)>;
+
+    FramePrefetcher(int first_frame, int last_frame, std::size_t depth, Loader loader);
+    ~FramePrefetcher();
+
+    FramePrefetcher(const FramePrefetcher&) = delete;
+    FramePrefetcher& operator=(const FramePrefetcher&) = delete;
+
+    // Blocks until the next frame is loaded; empty once the range is exhausted.
+    // Rethrows any error raised while loading that frame.
+    std::optional<Frame> next();
+
+private:
+    struct Slot
+    {
+        std::optional<Frame> frame;
+        std::exception_ptr error;
+    };
+
+    const int last_frame_;
+    const std::size_t depth_;
+    Loader loader_;
+    int next_to_consume_;
+    std::deque<Slot> ready_;
+    bool stopping_{false};
+    std::mutex mutex_;
+    std::condition_variable ready_changed_;
+    std::thread worker_;
+
+    void load_frames(int first_frame);
+};
+
+} // namespace sequence
+
+#endif // SEQUENCE_HPP
@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <cmath>
+
+#include "density.hpp"
+#include "primitives.hpp"
+#include "shadow.hpp"
+#include "stats.hpp"
+
+namespace shadow
+{
+
+bool ShadowVolume::update(const primitives::Box& box, const glm::vec3& light_direction)
+{
+    if (is_current(&box, box.density_revision(), box.bounds, box.grid_resolution, light_direction))
+    {
+        return false;
+    }
+
+    reset(&box, box.density_revision(), box.bounds, box.grid_resolution, light_direction);
+    sweep([&box](const glm::vec3& position) { return density::eval_grid(position, box); });
+    return true;
+}
+
+bool ShadowVolume::update(const primitives::Sphere& sphere, const glm::vec3& light_direction, int resolution,
+                          const perlin::Fbm& noise)
+{
+    const glm::vec3 extent{sphere.radius};
+    const std::array<glm::vec3, 2> bounds{sphere.center - extent, sphere.center + extent};
+    const std::uint64_t revision{perlin::parameters_hash(noise.parameters())};
+    if (is_current(&sphere, revision, bounds, resolution, light_direction))
+    {
+        return false;
+    }
+
+    reset(&sphere, revision, bounds, resolution, light_direction);
+    // The bounds enclose the sphere, but light is only attenuated inside it
+    sweep(
+        [&sphere, &noise](const glm::vec3& position)
+        {
+            if (glm::length(position - sphere.center) > sphere.radius)
+            {
+                return 0.0f;
+            }
+            return density::eval_fbm(position, sphere.center, sphere.radius, noise);
+        });
+    return true;
+}
+
+float ShadowVolume::optical_depth(const glm::vec3& position) const
+{
+    stats::count(stats::Counter::ShadowLookups);
+    const float max_lattice{static_cast<float>(resolution_ - 1)};
+    const glm::vec3 lattice_point{
+        glm::clamp(((position - bounds_[0]) / cell_size_) - 0.5f, glm::vec3{0.0f}, glm::vec3{max_lattice})};
+    const int x{std::min(static_cast<int>(lattice_point.x), resolution_ - 2)};
+    const int y{std::min(static_cast<int>(lattice_point.y), resolution_ - 2)};
+    const int z{std::min(static_cast<int>(lattice_point.z), resolution_ - 2)};
+    const glm::vec3 weight{lattice_point - glm::vec3{static_cast<float>(x), static_cast<float>(y),
+                                                     static_cast<float>(z)}};
+
+    const float c00{glm::mix(lattice_value(x, y, z), lattice_value(x + 1, y, z), weight.x)};
+    const float c10{glm::mix(lattice_value(x, y + 1, z), lattice_value(x + 1, y + 1, z), weight.x)};
+    const float c01{glm::mix(lattice_value(x, y, z + 1), lattice_value(x + 1, y, z + 1), weight.x)};
+    const float c11{glm::mix(lattice_value(x, y + 1, z + 1), lattice_value(x + 1, y + 1, z + 1), weight.x)};
+    return glm::mix(glm::mix(c00, c10, weight.y), glm::mix(c01, c11, weight.y), weight.z);
+}
+
+void ShadowVolume::optical_depth(const float* x, const float* y, const float* z, float* depths, int count) const
+{
+    stats::count(stats::Counter::ShadowLookups, static_cast<std::uint64_t>(count));
+    // The scalar lookup written out per coordinate, so that the loop vectorizes with gathers of the lattice values.
+    // 32-bit lattice indices keep the gathers narrow; lattices stay far below 2^31 points.
+    const float* values{optical_depth_.data()};
+    const int resolution{resolution_};
+    const float max_lattice{static_cast<float>(resolution - 1)};
+    const glm::vec3 origin{bounds_[0]};
+    const glm::vec3 cell_size{cell_size_};
+#pragma omp simd
+    for (int index = 0; index < count; ++index)
+    {
+        const float lattice_x{std::clamp(((x[index] - origin.x) / cell_size.x) - 0.5f, 0.0f, max_lattice)};
+        const float lattice_y{std::clamp(((y[index] - origin.y) / cell_size.y) - 0.5f, 0.0f, max_lattice)};
+        const float lattice_z{std::clamp(((z[index] - origin.z) / cell_size.z) - 0.5f, 0.0f, max_lattice)};
+        const int cell_x{std::min(static_cast<int>(lattice_x), resolution - 2)};
+        const int cell_y{std::min(static_cast<int>(lattice_y), resolution - 2)};
+        const int cell_z{std::min(static_cast<int>(lattice_z), resolution - 2)};
+        const float weight_x{lattice_x - static_cast<float>(cell_x)};
+        const float weight_y{lattice_y - static_cast<float>(cell_y)};
+        const float weight_z{lattice_z - static_cast<float>(cell_z)};
+
+        const int corner{(((cell_z * resolution) + cell_y) * resolution) + cell_x};
+        const int row{resolution};
+        const int slice{resolution * resolution};
+        const float c00{glm::mix(values[corner], values[corner + 1], weight_x)};
+        const float c10{glm::mix(values[corner + row], values[corner + row + 1], weight_x)};
+        const float c01{glm::mix(values[corner + slice], values[corner + slice + 1], weight_x)};
+        const float c11{glm::mix(values[corner + slice + row], values[corner + slice + row + 1], weight_x)};
+        depths[index] = glm::mix(glm::mix(c00, c10, weight_y), glm::mix(c01, c11, weight_y), weight_z);
+    }
+}
+
+bool ShadowVolume::is_current(const void* source, std::uint64_t revision, const std::array<glm::vec3, 2>& bounds,
+                              int resolution, const glm::vec3& light_direction) const
+{
+    return !optical_depth_.empty() && source_ == source && source_revision_ == revision && bounds_ == bounds &&
+           resolution_ == resolution && light_direction_ == light_direction;
+}
+
+void ShadowVolume::reset(const void* source, std::uint64_t revision, const std::array<glm::vec3, 2>& bounds,
+                         int resolution, const glm::vec3& light_direction)
+{
+    source_ = source;
+    source_revision_ = revision;
+    bounds_ = bounds;
+    resolution_ = std::max(resolution, 2);
+    cell_size_ = (bounds_[1] - bounds_[0]) / static_cast<float>(resolution_);
+    light_direction_ = light_direction;
+    optical_depth_.assign(static_cast<std::size_t>(resolution_) * resolution_ * resolution_, 0.0f);
+}
+
+template <typename DensityFunction>
+void ShadowVolume::sweep(const DensityFunction& density)
+{
+    // Slices are perpendicular to the dominant axis of the light direction; one step along the light
+    // moves a lattice point exactly onto the plane of the previous slice, which is already computed
+    int axis{0};
+    for (int i = 1; i < 3; ++i)
+    {
+        if (std::abs(light_direction_[i]) > std::abs(light_direction_[axis]))
+        {
+            axis = i;
+        }
+    }
+    const int u_axis{(axis + 1) % 3};
+    const int v_axis{(axis + 2) % 3};
+    const float step{cell_size_[axis] / std::abs(light_direction_[axis])};
+    const int first_slice{light_direction_[axis] > 0.0f ? resolution_ - 1 : 0};
+    const int slice_increment{light_direction_[axis] > 0.0f ? -1 : 1};
+    const int slice_size{resolution_ * resolution_};
+
+#pragma omp parallel
+    for (int sweep_index = 0; sweep_index < resolution_; ++sweep_index)
+    {
+        const int slice{first_slice + (sweep_index * slice_increment)};
+#pragma omp for schedule(static)
+        for (int index = 0; index < slice_size; ++index)
+        {
+            glm::ivec3 lattice{};
+            lattice[axis] = slice;
+            lattice[u_axis] = index % resolution_;
+            lattice[v_axis] = index / resolution_;
+            const glm::vec3 position{bounds_[0] + (glm::vec3{lattice} + 0.5f) * cell_size_};
+
+            // Distance along the light direction until the ray leaves the bounds
+            float exit_distance{step};
+            for (int i = 0; i < 3; ++i)
+            {
+                if (light_direction_[i] != 0.0f)
+                {
+                    const float plane{light_direction_[i] > 0.0f ? bounds_[1][i] : bounds_[0][i]};
+                    exit_distance = std::min(exit_distance, (plane - position[i]) / light_direction_[i]);
+                }
+            }
+
+            float depth{0.0f};
+            const float segment{std::max(exit_distance, 0.0f)};
+            if (sweep_index > 0 && exit_distance >= step)
+            {
+                // Bilinear lookup of the optical depth where the light ray crosses the previous slice
+                const glm::vec3 upstream{position + (light_direction_ * step)};
+                const float max_lattice{static_cast<float>(resolution_ - 1)};
+                const float u{std::clamp(((upstream[u_axis] - bounds_[0][u_axis]) / cell_size_[u_axis]) - 0.5f,
+                                         0.0f, max_lattice)};
+                const float v{std::clamp(((upstream[v_axis] - bounds_[0][v_axis]) / cell_size_[v_axis]) - 0.5f,
+                                         0.0f, max_lattice)};
+                const int u0{std::min(static_cast<int>(u), resolution_ - 2)};
+                const int v0{std::min(static_cast<int>(v), resolution_ - 2)};
+                glm::ivec3 corner{};
+                corner[axis] = slice - slice_increment;
+                const auto previous = [&](int du, int dv)
+                {
+                    corner[u_axis] = u0 + du;
+                    corner[v_axis] = v0 + dv;
+                    return lattice_value(corner.x, corner.y, corner.z);
+                };
+                const float bottom{glm::mix(previous(0, 0), previous(1, 0), u - static_cast<float>(u0))};
+                const float top{glm::mix(previous(0, 1), previous(1, 1), u - static_cast<float>(u0))};
+                depth = glm::mix(bottom, top, v - static_cast<float>(v0));
+            }
+
+            // Two-point midpoint rule over the segment between this point and the previous slice (or the boundary)
+            depth += 0.5f * segment *
+                     (density(position + (light_direction_ * (0.25f * segment))) +
+                      density(position + (light_direction_ * (0.75f * segment))));
+            optical_depth_[(static_cast<std::size_t>(lattice.z) * resolution_ + lattice.y) * resolution_ +
+                           lattice.x] = depth;
+        }
+    }
+}
+
+float ShadowVolume::lattice_value(int x, int y, int z) const
+{
+    return optical_depth_[(static_cast<std::size_t>(z) * resolution_ + y) * resolution_ + x];
+}
+
+} // namespace shadow
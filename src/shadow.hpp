@@ -0,0 +1,79 @@
+#ifndef SHADOW_HPP
+#define SHADOW_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Forward declarations
+namespace primitives
+{
+
+struct Box;
+struct Sphere;
+
+} // namespace primitives
+
+namespace perlin
+{
+
+class Fbm;
+
+} // namespace perlin
+
+namespace shadow
+{
+
+/*
+
+Light transmittance volume ("shadow volume").
+
+Stores, for each point of a regular lattice covering the volume bounds, the density
+integrated along the light direction up to the volume boundary. Values are per unit of
+extinction, so the transmittance towards the light at any position is
+exp(-optical_depth(position) * extinction_coeff) and editing the coefficients doesn't
+require a rebuild. The lattice is filled by sweeping slices along the dominant axis of the
+light direction, each slice reusing the optical depth of the previous one.
+
+*/
+
+class ShadowVolume
+{
+public:
+    // Rebuild the volume if the density or the light direction changed since the last call.
+    // Returns true if the volume was rebuilt.
+    bool update(const primitives::Box& box, const glm::vec3& light_direction);
+    // Density of the sphere: density::eval_fbm with the given noise
+    bool update(const primitives::Sphere& sphere, const glm::vec3& light_direction, int resolution,
+                const perlin::Fbm& noise);
+
+    // Trilinear lookup of the optical depth towards the light
+    float optical_depth(const glm::vec3& position) const;
+    // Lookups of count positions given as coordinate arrays, vectorized across positions
+    void optical_depth(const float* x, const float* y, const float* z, float* depths, int count) const;
+
+private:
+    std::array<glm::vec3, 2> bounds_{};
+    glm::vec3 cell_size_{};
+    int resolution_{0};
+    std::vector<float> optical_depth_;
+
+    // Inputs of the last build
+    glm::vec3 light_direction_{};
+    const void* source_{nullptr};
+    std::uint64_t source_revision_{0};
+
+    bool is_current(const void* source, std::uint64_t revision, const std::array<glm::vec3, 2>& bounds,
+                    int resolution, const glm::vec3& light_direction) const;
+    void reset(const void* source, std::uint64_t revision, const std::array<glm::vec3, 2>& bounds, int resolution,
+               const glm::vec3& light_direction);
+    template <typename DensityFunction>
+    void sweep(const DensityFunction& density);
+    float lattice_value(int x, int y, int z) const;
+};
+
+} // namespace shadow
+
+#endif // SHADOW_HPP
@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "sparse_grid.hpp"
+
+namespace grid
+{
+
+namespace
+{
+
+// Spreads the 3 bits of a brick-local coordinate so that they can be interleaved
+constexpr std::array<int, SparseGrid::brick_size> morton_bits{0b000000000, 0b000000001, 0b000001000, 0b000001001,
+                                                              0b001000000, 0b001000001, 0b001001000, 0b001001001};
+
+// IEEE 754 binary16 conversions, rounding to nearest even
+std::uint16_t float_to_half(float value)
+{
+    constexpr std::uint32_t half_overflow{(127 + 16) << 23};
+    constexpr std::uint32_t smallest_normal{113 << 23};
+    std::uint32_t bits{std::bit_cast<std::uint32_t>(value)};
+    const std::uint32_t sign{bits & 0x80000000u};
+    bits ^= sign;
+
+    std::uint32_t half{0};
+    if (bits >= half_overflow)
+    {
+        half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    }
+    else if (bits < smallest_normal)
+    {
+        // Let the float adder round the subnormal mantissa
+        const float denormal{std::bit_cast<float>(bits) + 0.5f};
+        half = std::bit_cast<std::uint32_t>(denormal) - std::bit_cast<std::uint32_t>(0.5f);
+    }
+    else
+    {
+        const std::uint32_t odd_mantissa{(bits >> 13) & 1u};
+        bits += (static_cast<std::uint32_t>(15 - 127) << 23) + 0xfffu + odd_mantissa;
+        half = bits >> 13;
+    }
+    return static_cast<std::uint16_t>(half | (sign >> 16));
+}
+
+float half_to_float(std::uint16_t half)
+{
+    constexpr std::uint32_t shifted_exponent{0x7c00u << 13};
+    std::uint32_t bits{(half & 0x7fffu) << 13u};
+    const std::uint32_t exponent{bits & shifted_exponent};
+    bits += (127 - 15) << 23;
+    if (exponent == shifted_exponent)
+    {
+        bits += (128 - 16) << 23;
+    }
+    else if (exponent == 0)
+    {
+        bits += 1 << 23;
+        bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits) - std::bit_cast<float>(113u << 23));
+    }
+    return std::bit_cast<float>(bits | ((half & 0x8000u) << 16u));
+}
+
+float decode_voxel(Encoding encoding, const SparseGrid::BrickRange& range, const std::uint8_t* brick, int offset)
+{
+    switch (encoding)
+    {
+    case Encoding::Float16:
+    {
+        std::uint16_t half{0};
+        std::memcpy(&half, brick + (offset * sizeof(std::uint16_t)), sizeof(half));
+        return range.offset + (range.scale * half_to_float(half));
+    }
+    case Encoding::UInt8:
+        return range.offset + (range.scale * static_cast<float>(brick[offset]));
+    default:
+    {
+        float value{0.0f};
+        std::memcpy(&value, brick + (offset * sizeof(float)), sizeof(value));
+        return value;
+    }
+    }
+}
+
+struct OwnedBricks
+{
+    std::vector<std::int32_t> table;
+    std::vector<SparseGrid::BrickRange> ranges;
+    std::vector<std::uint8_t> data;
+};
+
+} // namespace
+
+std::size_t bytes_per_voxel(Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::Float16:
+        return sizeof(std::uint16_t);
+    case Encoding::UInt8:
+        return sizeof(std::uint8_t);
+    default:
+        return sizeof(float);
+    }
+}
+
+// Encodes bricks into owned arrays, one layer of brick_size z-slices at a time
+class SparseGrid::Builder
+{
+public:
+    Builder(int resolution, Encoding encoding) :
+        resolution_{resolution}, bricks_per_axis_{(resolution + brick_size - 1) / brick_size}, encoding_{encoding}
+    {
+        bricks_.table.assign(static_cast<std::size_t>(bricks_per_axis_) * bricks_per_axis_ * bricks_per_axis_, -1);
+    }
+
+    int bricks_per_axis() const
+    {
+        return bricks_per_axis_;
+    }
+
+    // The slab holds the brick_size z-slices of the layer in dense z-y-x order
+    void insert_slab(int brick_z, const float* slab)
+    {
+        const std::size_t slice_size{static_cast<std::size_t>(resolution_) * resolution_};
+        const int slices{std::min(brick_size, resolution_ - (brick_z * brick_size))};
+        std::array<float, brick_voxels> voxels{};
+        for (int brick_y = 0; brick_y < bricks_per_axis_; ++brick_y)
+        {
+            for (int brick_x = 0; brick_x < bricks_per_axis_; ++brick_x)
+            {
+                // Gather the brick; voxels past the end of the grid stay zero
+                voxels.fill(0.0f);
+                bool occupied{false};
+                for (int z = 0; z < slices; ++z)
+                {
+                    for (int y = 0; y < brick_size && (brick_y * brick_size) + y < resolution_; ++y)
+                    {
+                        for (int x = 0; x < brick_size && (brick_x * brick_size) + x < resolution_; ++x)
+                        {
+                            const float value{
+                                slab[(slice_size * z) +
+                                     (static_cast<std::size_t>((brick_y * brick_size) + y) * resolution_) +
+                                     (brick_x * brick_size) + x]};
+                            voxels[brick_offset(glm::ivec3{x, y, z})] = value;
+                            occupied = occupied || (value != 0.0f);
+                        }
+                    }
+                }
+
+                if (occupied)
+                {
+                    bricks_.table[(static_cast<std::size_t>(brick_z) * bricks_per_axis_ + brick_y) * bricks_per_axis_ +
+                                  brick_x] = static_cast<std::int32_t>(bricks_.ranges.size());
+                    append_brick(voxels.data());
+                }
+            }
+        }
+    }
+
+    SparseGrid finish()
+    {
+        auto storage{std::make_shared<OwnedBricks>(std::move(bricks_))};
+        SparseGrid grid{from_external(resolution_, encoding_, storage->table, storage->ranges, storage->data, nullptr)};
+        grid.storage_ = std::move(storage);
+        return grid;
+    }
+
+private:
+    int resolution_;
+    int bricks_per_axis_;
+    Encoding encoding_;
+    OwnedBricks bricks_;
+
+    void append_brick(const float* voxels)
+    {
+        const auto [minimum, maximum] = std::minmax_element(voxels, voxels + brick_voxels);
+        BrickRange range{};
+        if (encoding_ == Encoding::Float16)
+        {
+            range.offset = *minimum;
+            range.scale = *maximum > *minimum ? *maximum - *minimum : 1.0f;
+        }
+        else if (encoding_ == Encoding::UInt8)
+        {
+            range.offset = *minimum;
+            range.scale = *maximum > *minimum ? (*maximum - *minimum) / 255.0f : 1.0f;
+        }
+
+        const std::size_t stride{bytes_per_voxel(encoding_)};
+        const std::size_t first_byte{bricks_.data.size()};
+        bricks_.data.resize(first_byte + (stride * brick_voxels));
+        std::uint8_t* brick{bricks_.data.data() + first_byte};
+        for (int i = 0; i < brick_voxels; ++i)
+        {
+            const float normalized{(voxels[i] - range.offset) / range.scale};
+            if (encoding_ == Encoding::Float16)
+            {
+                const std::uint16_t half{float_to_half(normalized)};
+                std::memcpy(brick + (stride * i), &half, stride);
+            }
+            else if (encoding_ == Encoding::UInt8)
+            {
+                brick[i] = static_cast<std::uint8_t>(std::clamp(std::lround(normalized), 0L, 255L));
+            }
+            else
+            {
+                std::memcpy(brick + (stride * i), &voxels[i], stride);
+            }
+        }
+
+        // The majorant must bound what lookups return, so take it from the decoded values
+        for (int i = 0; i < brick_voxels; ++i)
+        {
+            range.max = std::max(range.max, decode_voxel(encoding_, range, brick, i));
+        }
+        bricks_.ranges.push_back(range);
+    }
+};
+
+SparseGrid SparseGrid::from_dense(const std::vector<float>& values, int resolution, Encoding encoding)
+{
+    const std::size_t slice_size{static_cast<std::size_t>(resolution) * resolution};
+    if (values.size() < slice_size * resolution)
+    {
+        throw std::invalid_argument{"Dense grid is smaller than resolution^3"};
+    }
+
+    Builder builder{resolution, encoding};
+    for (int brick_z = 0; brick_z < builder.bricks_per_axis(); ++brick_z)
+    {
+        builder.insert_slab(brick_z, values.data() + (slice_size * brick_z * brick_size));
+    }
+    return builder.finish();
+}
+
+SparseGrid SparseGrid::read_raw(const std::string& filename, int resolution, Encoding encoding)
+{
+    std::ifstream stream{filename, std::ios::binary};
+    if (!stream)
+    {
+        throw std::runtime_error{"Failed to open grid cache " + filename};
+    }
+
+    Builder builder{resolution, encoding};
+    const std::size_t slice_size{static_cast<std::size_t>(resolution) * resolution};
+    std::vector<float> slab(slice_size * brick_size);
+    for (int brick_z = 0; brick_z < builder.bricks_per_axis(); ++brick_z)
+    {
+        const int slices{std::min(brick_size, resolution - (brick_z * brick_size))};
+        const auto bytes{static_cast<std::streamsize>(sizeof(float) * slice_size * slices)};
+        if (!stream.read(reinterpret_cast<char*>(slab.data()), bytes))
+        {
+            throw std::runtime_error{"Grid cache " + filename + " is shorter than resolution^3 floats"};
+        }
+        builder.insert_slab(brick_z, slab.data());
+    }
+    return builder.finish();
+}
+
+SparseGrid SparseGrid::from_external(int resolution, Encoding encoding, std::span<const std::int32_t> brick_table,
+                                     std::span<const BrickRange> brick_ranges,
+                                     std::span<const std::uint8_t> brick_data, std::shared_ptr<const void> owner)
+{
+    SparseGrid grid{};
+    grid.resolution_ = resolution;
+    grid.bricks_per_axis_ = (resolution + brick_size - 1) / brick_size;
+    grid.encoding_ = encoding;
+    const std::size_t table_size{static_cast<std::size_t>(grid.bricks_per_axis_) * grid.bricks_per_axis_ *
+                                 grid.bricks_per_axis_};
+    if (brick_table.size() != table_size ||
+        brick_data.size() != brick_ranges.size() * brick_voxels * bytes_per_voxel(encoding))
+    {
+        throw std::invalid_argument{"Brick arrays don't match the grid resolution"};
+    }
+    // The arrays usually map a file, so a corrupt one must not make lookups read past them
+    const auto brick_count{static_cast<std::int64_t>(brick_ranges.size())};
+    if (std::ranges::any_of(brick_table,
+                            [brick_count](std::int32_t index) { return index < -1 || index >= brick_count; }))
+    {
+        throw std::invalid_argument{"Brick table refers to bricks that don't exist"};
+    }
+    if (std::ranges::any_of(brick_ranges,
+                            [](const BrickRange& range)
+                            {
+                                return !std::isfinite(range.offset) || !std::isfinite(range.scale) ||
+                                       !std::isfinite(range.max) || range.max < 0.0f;
+                            }))
+    {
+        throw std::invalid_argument{"Brick ranges hold invalid values"};
+    }
+
+    grid.brick_table_ = brick_table;
+    grid.brick_ranges_ = brick_ranges;
+    grid.brick_data_ = brick_data;
+    grid.storage_ = std::move(owner);
+    return grid;
+}
+
+int SparseGrid::resolution() const
+{
+    return resolution_;
+}
+
+int SparseGrid::bricks_per_axis() const
+{
+    return bricks_per_axis_;
+}
+
+Encoding SparseGrid::encoding() const
+{
+    return encoding_;
+}
+
+std::size_t SparseGrid::allocated_bricks() const
+{
+    return brick_ranges_.size();
+}
+
+std::size_t SparseGrid::memory_usage() const
+{
+    return brick_table_.size_bytes() + brick_ranges_.size_bytes() + brick_data_.size_bytes();
+}
+
+float SparseGrid::value(const glm::ivec3& voxel) const
+{
+    if (voxel.x < 0 || voxel.x >= resolution_ || voxel.y < 0 || voxel.y >= resolution_ || voxel.z < 0 ||
+        voxel.z >= resolution_)
+    {
+        return 0.0f;
+    }
+
+    const std::int32_t index{brick_index(voxel / brick_size)};
+    if (index < 0)
+    {
+        return 0.0f;
+    }
+
+    return decode(index, brick_offset(voxel % brick_size));
+}
+
+void SparseGrid::gather(const glm::ivec3& corner, float* values) const
+{
+    // Negative coordinates wrap to large unsigned values, so one comparison per axis checks both ends. Voxels
+    // past the resolution inside the last bricks are stored as zero and need no check.
+    const auto block_in_brick = [this](int coordinate)
+    {
+        return static_cast<unsigned int>(coordinate) < static_cast<unsigned int>(bricks_per_axis_ * brick_size) &&
+               (coordinate % brick_size) < brick_size - 1;
+    };
+    if (!(block_in_brick(corner.x) && block_in_brick(corner.y) && block_in_brick(corner.z)))
+    {
+        for (int corner_index = 0; corner_index < 8; ++corner_index)
+        {
+            values[corner_index] =
+                value(corner + glm::ivec3{corner_index & 1, (corner_index >> 1) & 1, (corner_index >> 2) & 1});
+        }
+        return;
+    }
+
+    const std::int32_t index{brick_index(corner / brick_size)};
+    if (index < 0)
+    {
+        std::fill(values, values + 8, 0.0f);
+        return;
+    }
+
+    const glm::ivec3 local{corner % brick_size};
+    const std::uint8_t* brick{brick_data_.data() + (bytes_per_voxel(encoding_) * brick_voxels * index)};
+    const BrickRange& range{brick_ranges_[index]};
+    for (int corner_index = 0; corner_index < 8; ++corner_index)
+    {
+        const int offset{morton_bits[local.x + (corner_index & 1)] |
+                         (morton_bits[local.y + ((corner_index >> 1) & 1)] << 1) |
+                         (morton_bits[local.z + ((corner_index >> 2) & 1)] << 2)};
+        values[corner_index] = decode_voxel(encoding_, range, brick, offset);
+    }
+}
+
+float SparseGrid::brick_max(const glm::ivec3& brick_coord) const
+{
+    if (brick_coord.x < 0 || brick_coord.x >= bricks_per_axis_ || brick_coord.y < 0 ||
+        brick_coord.y >= bricks_per_axis_ || brick_coord.z < 0 || brick_coord.z >= bricks_per_axis_)
+    {
+        return 0.0f;
+    }
+
+    const std::int32_t index{brick_index(brick_coord)};
+    return index < 0 ? 0.0f : brick_ranges_[index].max;
+}
+
+int SparseGrid::brick_offset(const glm::ivec3& voxel_in_brick)
+{
+    return morton_bits[voxel_in_brick.x] | (morton_bits[voxel_in_brick.y] << 1) | (morton_bits[voxel_in_brick.z] << 2);
+}
+
+std::span<const std::int32_t> SparseGrid::brick_table() const
+{
+    return brick_table_;
+}
+
+std::span<const SparseGrid::BrickRange> SparseGrid::brick_ranges() const
+{
+    return brick_ranges_;
+}
+
+std::span<const std::uint8_t> SparseGrid::brick_data() const
+{
+    return brick_data_;
+}
+
+std::int32_t SparseGrid::brick_index(const glm::ivec3& brick_coord) const
+{
+    return brick_table_[(static_cast<std::size_t>(brick_coord.z) * bricks_per_axis_ + brick_coord.y) *
+                            bricks_per_axis_ +
+                        brick_coord.x];
+}
+
+float SparseGrid::decode(std::int32_t index, int offset) const
+{
+    const std::size_t brick_bytes{bytes_per_voxel(encoding_) * brick_voxels};
+    return decode_voxel(encoding_, brick_ranges_[index], brick_data_.data() + (brick_bytes * index), offset);
+}
+
+} // namespace grid
@@ -0,0 +1,106 @@
+#ifndef SPARSE_GRID_HPP
+#define SPARSE_GRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace grid
+{
+
+// Storage format of the voxels of a grid. Float16 and UInt8 store each voxel relative to
+// the value range of its brick, decoded as offset + scale * stored_value.
+enum class Encoding : std::uint8_t
+{
+    Float32 = 0,
+    Float16 = 1,
+    UInt8 = 2,
+};
+
+std::size_t bytes_per_voxel(Encoding encoding);
+
+/*
+
+Sparse bricked voxel grid.
+
+The cubic grid is split into bricks of brick_size^3 voxels and only bricks holding a non-zero
+voxel are allocated; every other voxel reads as zero. Voxels inside a brick are stored in Morton
+order, so neighbouring voxels along any axis (and rays that are not axis-aligned) stay within a
+few cache lines. Bricks can be stored quantized to cut memory and bandwidth by 2-4x.
+
+The brick data is immutable once built and shared between copies of a grid; it is either owned
+by the grid or borrowed from a memory-mapped file (see grid_file.hpp).
+
+*/
+
+class SparseGrid
+{
+public:
+    static constexpr int brick_size{8};
+    static constexpr int brick_voxels{brick_size * brick_size * brick_size};
+
+    // Per-brick decoding parameters and the maximum decoded value of the brick
+    struct BrickRange
+    {
+        float offset{0.0f};
+        float scale{1.0f};
+        float max{0.0f};
+    };
+
+    SparseGrid() = default;
+
+    // Dense input is ordered z-y-x, as in the raw simulation caches
+    static SparseGrid from_dense(const std::vector<float>& values, int resolution,
+                                 Encoding encoding = Encoding::Float32);
+    // Reads (and converts) a raw z-y-x float cache a few slices at a time, so the dense grid is
+    // never held in memory
+    static SparseGrid read_raw(const std::string& filename, int resolution, Encoding encoding = Encoding::Float32);
+    // Wraps existing brick arrays without copying them; owner keeps the memory alive
+    static SparseGrid from_external(int resolution, Encoding encoding, std::span<const std::int32_t> brick_table,
+                                    std::span<const BrickRange> brick_ranges, std::span<const std::uint8_t> brick_data,
+                                    std::shared_ptr<const void> owner);
+
+    int resolution() const;
+    int bricks_per_axis() const;
+    Encoding encoding() const;
+    std::size_t allocated_bricks() const;
+    std::size_t memory_usage() const;
+
+    // Zero outside of the grid and inside unallocated bricks
+    float value(const glm::ivec3& voxel) const;
+    // Values of the 2x2x2 voxels from corner to corner + 1, x fastest, as value() would return them.
+    // Blocks within one brick (7 of 8 corners per axis) resolve the brick once.
+    void gather(const glm::ivec3& corner, float* values) const;
+    // Maximum decoded value of a brick; zero if the brick is empty or outside of the grid
+    float brick_max(const glm::ivec3& brick_coord) const;
+    static int brick_offset(const glm::ivec3& voxel_in_brick);
+
+    // Raw brick arrays: table of brick indices (-1 for empty bricks) in z-y-x order,
+    // ranges and encoded voxels of the allocated bricks
+    std::span<const std::int32_t> brick_table() const;
+    std::span<const BrickRange> brick_ranges() const;
+    std::span<const std::uint8_t> brick_data() const;
+
+private:
+    class Builder;
+
+    int resolution_{0};
+    int bricks_per_axis_{0};
+    Encoding encoding_{Encoding::Float32};
+    std::span<const std::int32_t> brick_table_;
+    std::span<const BrickRange> brick_ranges_;
+    std::span<const std::uint8_t> brick_data_;
+    std::shared_ptr<const void> storage_;
+
+    std::int32_t brick_index(const glm::ivec3& brick_coord) const;
+    float decode(std::int32_t index, int offset) const;
+};
+
+} // namespace grid
+
+#endif // SPARSE_GRID_HPP
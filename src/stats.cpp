@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "stats.hpp"
+
+namespace stats
+{
+
+const char* counter_name(Counter counter)
+{
+    switch (counter)
+    {
+    case Counter::MarchSteps:
+        return "march steps";
+    case Counter::LightSteps:
+        return "light steps";
+    case Counter::ShadowLookups:
+        return "shadow lookups";
+    case Counter::GridLookups:
+        return "grid lookups";
+    case Counter::FbmEvaluations:
+        return "fbm evaluations";
+    case Counter::RouletteTerminations:
+        return "roulette terminations";
+    case Counter::VisitedVoxels:
+        return "visited voxels";
+    case Counter::SkippedVoxels:
+        return "skipped voxels";
+    case Counter::AdaptiveSamples:
+        return "adaptive samples";
+    case Counter::FixedStepSamples:
+        return "fixed step samples";
+    default:
+        return "unknown";
+    }
+}
+
+Counters& Counters::operator+=(const Counters& other)
+{
+    for (std::size_t counter = 0; counter < counter_count; ++counter)
+    {
+        values[counter] += other.values[counter];
+    }
+    return *this;
+}
+
+std::uint64_t Counters::events() const
+{
+    std::uint64_t sum{0};
+    for (std::size_t counter = 0; counter < event_counter_count; ++counter)
+    {
+        sum += values[counter];
+    }
+    return sum;
+}
+
+int thread_index()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+int max_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+double FrameStats::imbalance() const
+{
+    if (threads.empty())
+    {
+        return 1.0;
+    }
+
+    double busiest{0.0};
+    double total{0.0};
+    for (const ThreadLoad& thread : threads)
+    {
+        busiest = std::max(busiest, thread.busy_seconds);
+        total += thread.busy_seconds;
+    }
+    return total > 0.0 ? busiest * static_cast<double>(threads.size()) / total : 1.0;
+}
+
+void print(std::ostream& stream, const FrameStats& frame)
+{
+    const double pixels{static_cast<double>(std::max<std::uint64_t>(frame.pixels, 1))};
+    stream << "Render statistics: " << frame.pixels << " pixels, " << frame.samples << " samples in "
+           << frame.seconds << " seconds\n";
+    for (std::size_t counter = 0; counter < counter_count; ++counter)
+    {
+        const std::uint64_t value{frame.totals.values[counter]};
+        stream << "  " << std::left << std::setw(24) << counter_name(static_cast<Counter>(counter)) << std::right
+               << std::setw(14) << value << "  (" << static_cast<double>(value) / pixels << " per pixel)\n";
+    }
+
+    const auto total = [&](Counter counter) { return static_cast<double>(frame.totals[counter]); };
+    const double walked_voxels{total(Counter::VisitedVoxels) + total(Counter::SkippedVoxels)};
+    if (walked_voxels > 0.0)
+    {
+        stream << "  empty space skipping: " << (100.0 * total(Counter::SkippedVoxels) / walked_voxels)
+               << "% of voxel steps skipped\n";
+    }
+    if (total(Counter::FixedStepSamples) > 0.0)
+    {
+        stream << "  adaptive marching: "
+               << ((total(Counter::FixedStepSamples) - total(Counter::AdaptiveSamples)) / pixels)
+               << " samples saved per pixel\n";
+    }
+
+    stream << "  thread load (imbalance " << frame.imbalance() << "):\n";
+    for (std::size_t thread = 0; thread < frame.threads.size(); ++thread)
+    {
+        const ThreadLoad& load{frame.threads[thread]};
+        stream << "    thread " << std::setw(3) << thread << ": " << std::setw(9) << load.pixels << " pixels, "
+               << std::setw(10) << load.counters.events() << " events, " << load.busy_seconds << " s busy\n";
+    }
+}
+
+sf::Image heatmap_image(const std::vector<float>& values, const sf::Vector2u& size, std::uint8_t alpha)
+{
+    // The 99th percentile keeps a few outliers from darkening the whole map
+    std::vector<float> sorted{values};
+    const auto percentile{sorted.begin() + static_cast<std::ptrdiff_t>(sorted.size() * 99 / 100)};
+    float scale{0.0f};
+    if (percentile != sorted.end())
+    {
+        std::nth_element(sorted.begin(), percentile, sorted.end());
+        scale = *percentile > 0.0f ? 1.0f / *percentile : 0.0f;
+    }
+
+    std::vector<std::uint8_t> rgba(static_cast<std::size_t>(size.x) * size.y * 4);
+    for (std::size_t pixel = 0; pixel < values.size(); ++pixel)
+    {
+        // Black through red and yellow to white
+        const float cost{std::clamp(values[pixel] * scale, 0.0f, 1.0f)};
+        for (std::size_t channel = 0; channel < 3; ++channel)
+        {
+            const float level{std::clamp(3.0f * cost - static_cast<float>(channel), 0.0f, 1.0f)};
+            rgba[4 * pixel + channel] = static_cast<std::uint8_t>(255.0f * level);
+        }
+        rgba[4 * pixel + 3] = alpha;
+    }
+
+    sf::Image image;
+    image.create(size.x, size.y, rgba.data());
+    return image;
+}
+
+} // namespace stats
@@ -0,0 +1,137 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/System/Vector2.hpp>
+
+namespace stats
+{
+
+/*
+
+Hot-path render statistics. Tracers and density lookups count events with stats::count, which adds
+to counters of the calling thread only; render::Context takes them after every pixel to build a
+per-pixel cost map and per-thread loads, and sums those into frame totals when a render ends.
+
+Counting is compiled in only when VOLRENDER_STATS is defined (CMake option of the same name).
+Otherwise enabled is false, count() is empty and Context leaves out the collection code, so
+instrumented code paths cost nothing.
+
+*/
+
+#ifdef VOLRENDER_STATS
+constexpr bool enabled{true};
+#else
+constexpr bool enabled{false};
+#endif
+
+enum class Counter : std::uint8_t
+{
+    // Samples of the view ray: march steps, voxel segments or delta tracking candidates
+    MarchSteps,
+    // Samples along light paths: light march steps or ratio tracking candidates
+    LightSteps,
+    ShadowLookups,
+    GridLookups,
+    FbmEvaluations,
+    RouletteTerminations,
+    // Reports on the acceleration of the march, which restate or avoid the work counted above and are
+    // left out of events(): voxels visited and skipped by traversal::walk_occupied_voxels, samples taken
+    // by adaptive marches and the samples the fixed step would have taken over the same distance
+    VisitedVoxels,
+    SkippedVoxels,
+    AdaptiveSamples,
+    FixedStepSamples,
+    Count,
+};
+
+constexpr std::size_t counter_count{static_cast<std::size_t>(Counter::Count)};
+constexpr std::size_t event_counter_count{static_cast<std::size_t>(Counter::VisitedVoxels)};
+
+const char* counter_name(Counter counter);
+
+struct Counters
+{
+    std::array<std::uint64_t, counter_count> values{};
+
+    std::uint64_t& operator[](Counter counter)
+    {
+        return values[static_cast<std::size_t>(counter)];
+    }
+    std::uint64_t operator[](Counter counter) const
+    {
+        return values[static_cast<std::size_t>(counter)];
+    }
+    Counters& operator+=(const Counters& other);
+    // Sum over the work counters, the event cost shown by the heatmap
+    std::uint64_t events() const;
+};
+
+// Events counted on the calling thread since its counters were last taken
+inline thread_local Counters thread_counters{};
+
+inline void count([[maybe_unused]] Counter counter, [[maybe_unused]] std::uint64_t amount = 1)
+{
+    if constexpr (enabled)
+    {
+        thread_counters[counter] += amount;
+    }
+}
+
+// Returns the counters of the calling thread and starts them over
+inline Counters take_thread_counters()
+{
+    const Counters counters{thread_counters};
+    thread_counters = Counters{};
+    return counters;
+}
+
+// Index of the calling render thread, below max_threads()
+int thread_index();
+int max_threads();
+
+// Work done by one render thread; padded so that threads never write the same cache line
+struct alignas(64) ThreadLoad
+{
+    std::uint64_t pixels{0};
+    std::uint64_t samples{0};
+    double busy_seconds{0.0};
+    Counters counters{};
+};
+
+struct FrameStats
+{
+    Counters totals{};
+    std::uint64_t pixels{0};
+    std::uint64_t samples{0};
+    double seconds{0.0};
+    // Threads that took part in the render
+    std::vector<ThreadLoad> threads;
+
+    // Busiest thread's time over the mean busy time of all threads, 1 when perfectly balanced
+    double imbalance() const;
+};
+
+void print(std::ostream& stream, const FrameStats& frame);
+
+enum class HeatmapMetric : std::uint8_t
+{
+    // Wall time spent on each pixel
+    Time,
+    // Counted events of each pixel
+    Events,
+};
+
+// Colours size.x * size.y values, row by row, from dark (cheap) to bright (expensive), scaled so that the
+// 99th percentile is the brightest; pixels get alpha for blending over a render
+sf::Image heatmap_image(const std::vector<float>& values, const sf::Vector2u& size, std::uint8_t alpha = 255);
+
+} // namespace stats
+
+#endif // STATS_HPP
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <omp.h>
+
+#include "tiles.hpp"
+
+namespace tiles
+{
+
+namespace
+{
+
+class WorkDeque
+{
+public:
+    void push_back(const Tile* tile)
+    {
+        std::lock_guard lock{mutex_};
+        tiles_.push_back(tile);
+    }
+
+    const Tile* pop_front()
+    {
+        std::lock_guard lock{mutex_};
+        if (tiles_.empty())
+        {
+            return nullptr;
+        }
+        const Tile* tile{tiles_.front()};
+        tiles_.pop_front();
+        return tile;
+    }
+
+    const Tile* steal_back()
+    {
+        std::lock_guard lock{mutex_};
+        if (tiles_.empty())
+        {
+            return nullptr;
+        }
+        const Tile* tile{tiles_.back()};
+        tiles_.pop_back();
+        return tile;
+    }
+
+private:
+    std::deque<const Tile*> tiles_;
+    std::mutex mutex_;
+};
+
+} // namespace
+
+std::vector<Tile> spiral_tiles(const sf::Vector2u& image_size, std::uint32_t tile_size)
+{
+    tile_size = std::max<std::uint32_t>(tile_size, 1);
+    const int tiles_x{static_cast<int>((image_size.x + tile_size - 1) / tile_size)};
+    const int tiles_y{static_cast<int>((image_size.y + tile_size - 1) / tile_size)};
+    const std::size_t tile_count{static_cast<std::size_t>(tiles_x) * static_cast<std::size_t>(tiles_y)};
+
+    std::vector<Tile> tiles;
+    tiles.reserve(tile_count);
+    const auto add_tile = [&](int x, int y)
+    {
+        if (x < 0 || y < 0 || x >= tiles_x || y >= tiles_y)
+        {
+            return;
+        }
+        const std::uint32_t x0{static_cast<std::uint32_t>(x) * tile_size};
+        const std::uint32_t y0{static_cast<std::uint32_t>(y) * tile_size};
+        tiles.push_back(Tile{.x0 = x0,
+                             .y0 = y0,
+                             .x1 = std::min(x0 + tile_size, image_size.x),
+                             .y1 = std::min(y0 + tile_size, image_size.y)});
+    };
+
+    // Square spiral: legs of length 1, 1, 2, 2, 3, 3, ... turning right after each leg.
+    // Tiles of the spiral outside the image are skipped.
+    constexpr int directions[4][2]{{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+    int x{(tiles_x - 1) / 2};
+    int y{(tiles_y - 1) / 2};
+    add_tile(x, y);
+    for (int leg = 0; tiles.size() < tile_count; ++leg)
+    {
+        const int length{leg / 2 + 1};
+        for (int step = 0; step < length; ++step)
+        {
+            x += directions[leg % 4][0];
+            y += directions[leg % 4][1];
+            add_tile(x, y);
+        }
+    }
+    return tiles;
+}
+
+bool TileScheduler::run(const std::vector<Tile>& tiles, const RenderTile& render_tile, std::stop_token stop,
+                        const TileDone& tile_done)
+{
+    const int thread_count{omp_get_max_threads()};
+    std::unique_ptr<WorkDeque[]> deques{std::make_unique<WorkDeque[]>(static_cast<std::size_t>(thread_count))};
+    for (std::size_t index = 0; index < tiles.size(); ++index)
+    {
+        deques[index % static_cast<std::size_t>(thread_count)].push_back(&tiles[index]);
+    }
+
+    std::atomic<std::size_t> completed{0};
+#pragma omp parallel num_threads(thread_count)
+    {
+        const int thread{omp_get_thread_num()};
+        const auto next_tile = [&]() -> const Tile*
+        {
+            if (const Tile* tile{deques[thread].pop_front()})
+            {
+                return tile;
+            }
+            for (int offset = 1; offset < thread_count; ++offset)
+            {
+                if (const Tile* tile{deques[(thread + offset) % thread_count].steal_back()})
+                {
+                    return tile;
+                }
+            }
+            return nullptr;
+        };
+
+        while (!stop.stop_requested())
+        {
+            const Tile* tile{next_tile()};
+            if (tile == nullptr)
+            {
+                break;
+            }
+            render_tile(*tile, static_cast<std::size_t>(tile - tiles.data()), stop);
+            if (stop.stop_requested())
+            {
+                break;
+            }
+            completed.fetch_add(1, std::memory_order_relaxed);
+            if (tile_done)
+            {
+                tile_done(*tile);
+            }
+        }
+    }
+    return completed.load() == tiles.size();
+}
+
+} // namespace tiles
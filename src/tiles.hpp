@@ -0,0 +1,57 @@
+#ifndef TILES_HPP
+#define TILES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stop_token>
+#include <vector>
+
+#include <SFML/System/Vector2.hpp>
+
+namespace tiles
+{
+
+// Pixel rectangle [x0, x1) x [y0, y1) of the image
+struct Tile
+{
+    std::uint32_t x0{0};
+    std::uint32_t y0{0};
+    std::uint32_t x1{0};
+    std::uint32_t y1{0};
+};
+
+constexpr std::uint32_t default_tile_size{16};
+
+// Covers the image with tiles ordered along a square spiral from the centre, so the
+// middle of the image (where the volume usually is) finishes first
+std::vector<Tile> spiral_tiles(const sf::Vector2u& image_size, std::uint32_t tile_size = default_tile_size);
+
+/*
+
+Renders tiles on the OpenMP threads. Tiles are dealt round-robin to one deque per thread
+in spiral order; a thread takes work from the front of its own deque and, once empty,
+steals from the back of the others, which balances expensive volume tiles against cheap
+background tiles.
+
+Cancellation is cooperative: no tile starts after stop is requested, and render_tile
+may poll the stop token itself to abandon a tile early.
+
+*/
+
+class TileScheduler
+{
+public:
+    // Gets the tile and its index in the tiles passed to run, for callers keeping per-tile state
+    using RenderTile = std::function<void(const Tile&, std::size_t, std::stop_token)>;
+    // Called on the worker thread after each completed (not abandoned) tile
+    using TileDone = std::function<void(const Tile&)>;
+
+    // Returns false if the render was cancelled before every tile finished
+    bool run(const std::vector<Tile>& tiles, const RenderTile& render_tile, std::stop_token stop = {},
+             const TileDone& tile_done = {});
+};
+
+} // namespace tiles
+
+#endif // TILES_HPP
@@ -0,0 +1,196 @@
+#ifndef TRAVERSAL_HPP
+#define TRAVERSAL_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "majorant.hpp"
+#include "primitives.hpp"
+#include "ray.hpp"
+#include "stats.hpp"
+
+namespace traversal
+{
+
+/*
+
+Amanatides-Woo 3D-DDA over a regular lattice of cubic cells.
+
+Visits, in order along the ray, every cell crossed by the ray parameter interval [t_min, t_max],
+calling visit(cell, t_enter, t_exit); returning false from visit stops the walk and is returned.
+Cell indices are clamped to [-1, resolution - 1] at the entry point.
+The ray must have its inverse direction computed.
+
+*/
+
+template <typename Visitor>
+bool walk_cells(const geometry::Ray& ray, const glm::vec3& lattice_origin, const glm::vec3& cell_size, int resolution,
+                float t_min, float t_max, Visitor&& visit)
+{
+    if (t_max <= t_min)
+    {
+        return true;
+    }
+
+    const glm::vec3 entry{(ray.evaluate(t_min) - lattice_origin) / cell_size};
+    glm::ivec3 cell{};
+    glm::ivec3 step{};
+    glm::vec3 t_next{};
+    glm::vec3 t_delta{};
+    for (int i = 0; i < 3; ++i)
+    {
+        cell[i] = std::clamp(static_cast<int>(std::floor(entry[i])), -1, resolution - 1);
+        step[i] = ray.sign[i] ? -1 : 1;
+        if (ray.direction[i] == 0.0f)
+        {
+            t_next[i] = std::numeric_limits<float>::infinity();
+            t_delta[i] = std::numeric_limits<float>::infinity();
+            continue;
+        }
+
+        const float boundary{lattice_origin[i] + (static_cast<float>(cell[i] + (step[i] > 0 ? 1 : 0)) * cell_size[i])};
+        t_next[i] = (boundary - ray.origin[i]) * ray.inv_direction[i];
+        t_delta[i] = cell_size[i] * std::abs(ray.inv_direction[i]);
+    }
+
+    float t_enter{t_min};
+    while (t_enter < t_max)
+    {
+        int axis{t_next.x < t_next.y ? 0 : 1};
+        axis = t_next.z < t_next[axis] ? 2 : axis;
+        const float t_exit{std::clamp(t_next[axis], t_enter, t_max)};
+        if (!visit(cell, t_enter, t_exit))
+        {
+            return false;
+        }
+
+        t_enter = t_exit;
+        cell[axis] += step[axis];
+        t_next[axis] += t_delta[axis];
+    }
+    return true;
+}
+
+/*
+
+Walks the density cells of a Box. Cells follow the lattice of density::eval_grid (offset by half
+a voxel from the bounds), so a cell index may be -1 on the lower faces of the box;
+density::eval_voxel returns zero for such cells.
+
+*/
+
+template <typename Visitor>
+bool walk_voxels(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max, Visitor&& visit)
+{
+    const glm::vec3 voxel_size{(box.bounds[1] - box.bounds[0]) / static_cast<float>(box.grid_resolution)};
+    const glm::vec3 lattice_origin{box.bounds[0] + (0.5f * voxel_size)};
+    return walk_cells(ray, lattice_origin, voxel_size, box.grid_resolution, t_min, t_max, visit);
+}
+
+/*
+
+Descends the majorant pyramid of the Box and visits, in order along the ray, the level-0 bricks
+with a non-zero majorant, calling visit(brick, t_enter, t_exit), and skip(t_enter, t_exit) for the
+empty bricks and pyramid cells in between. Bricks use the lattice of walk_voxels, brick_size voxels
+per axis each.
+The lattice cell at index -1 on the lower faces lies outside the pyramid, but filtered lookups there
+still blend in voxel 0, so it is bounded by, and visited as, the adjacent brick.
+
+*/
+
+template <typename Visitor, typename SkipVisitor>
+bool walk_occupied_bricks(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max,
+                          Visitor&& visit, SkipVisitor&& skip)
+{
+    const majorant::MajorantGrid& majorants{box.majorants};
+    if (majorants.levels() == 0)
+    {
+        return true;
+    }
+
+    const glm::vec3 voxel_size{(box.bounds[1] - box.bounds[0]) / static_cast<float>(box.grid_resolution)};
+    const glm::vec3 lattice_origin{box.bounds[0] + (0.5f * voxel_size)};
+    const auto walk_level = [&](const auto& self, int level, float t_enter, float t_exit) -> bool
+    {
+        const float brick_voxels{static_cast<float>(majorants.level_brick_size(level))};
+        return walk_cells(ray, lattice_origin, voxel_size * brick_voxels, majorants.level_resolution(level), t_enter,
+                          t_exit,
+                          [&](const glm::ivec3& cell, float brick_enter, float brick_exit)
+                          {
+                              const glm::ivec3 brick{glm::max(cell, glm::ivec3{0})};
+                              if (majorants.max_density(level, brick) <= 0.0f)
+                              {
+                                  skip(brick_enter, brick_exit);
+                                  return true;
+                              }
+                              if (level > 0)
+                              {
+                                  return self(self, level - 1, brick_enter, brick_exit);
+                              }
+                              return visit(brick, brick_enter, brick_exit);
+                          });
+    };
+
+    return walk_level(walk_level, majorants.levels() - 1, t_min, t_max);
+}
+
+// Same, ignoring the empty bricks
+template <typename Visitor>
+bool walk_occupied_bricks(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max,
+                          Visitor&& visit)
+{
+    return walk_occupied_bricks(ray, box, t_min, t_max, visit, [](float /*t_enter*/, float /*t_exit*/) {});
+}
+
+/*
+
+Same as walk_voxels, but only voxels inside occupied bricks (see walk_occupied_bricks) are visited.
+Counts the visited voxels and the voxels of the skipped bricks as stats::Counter::VisitedVoxels and
+SkippedVoxels.
+
+*/
+
+template <typename Visitor>
+bool walk_occupied_voxels(const geometry::Ray& ray, const primitives::Box& box, float t_min, float t_max,
+                          Visitor&& visit)
+{
+    if (box.majorants.levels() == 0)
+    {
+        return walk_voxels(ray, box, t_min, t_max, visit);
+    }
+
+    const glm::vec3 voxel_size{(box.bounds[1] - box.bounds[0]) / static_cast<float>(box.grid_resolution)};
+    const glm::vec3 lattice_origin{box.bounds[0] + (0.5f * voxel_size)};
+    return walk_occupied_bricks(
+        ray, box, t_min, t_max,
+        [&](const glm::ivec3& /*brick*/, float brick_enter, float brick_exit)
+        {
+            return walk_cells(ray, lattice_origin, voxel_size, box.grid_resolution, brick_enter, brick_exit,
+                              [&](const glm::ivec3& voxel, float voxel_enter, float voxel_exit)
+                              {
+                                  stats::count(stats::Counter::VisitedVoxels);
+                                  return visit(voxel, voxel_enter, voxel_exit);
+                              });
+        },
+        [&]([[maybe_unused]] float brick_enter, [[maybe_unused]] float brick_exit)
+        {
+            if constexpr (stats::enabled)
+            {
+                // Number of voxels the DDA would have visited in the skipped brick
+                const float inset{1e-4f * (brick_exit - brick_enter)};
+                const glm::vec3 first{glm::floor((ray.evaluate(brick_enter + inset) - lattice_origin) / voxel_size)};
+                const glm::vec3 last{glm::floor((ray.evaluate(brick_exit - inset) - lattice_origin) / voxel_size)};
+                const glm::vec3 crossings{glm::abs(last - first)};
+                stats::count(stats::Counter::SkippedVoxels,
+                             static_cast<std::uint64_t>(1.0f + crossings.x + crossings.y + crossings.z));
+            }
+        });
+}
+
+} // namespace traversal
+
+#endif // TRAVERSAL_HPP
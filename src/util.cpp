@@ -22,4 +22,14 @@ geometry::Ray transform_ray(const glm::mat4& matrix, glm::vec3 camera_origin, gl
     return geometry::Ray{.origin = origin_world, .direction = glm::normalize(ray_dir)};
 }
 
+std::uint64_t hash_bytes(const void* data, std::size_t size, std::uint64_t hash)
+{
+    const unsigned char* bytes{static_cast<const unsigned char*>(data)};
+    for (std::size_t index = 0; index < size; ++index)
+    {
+        hash = (hash ^ bytes[index]) * 1099511628211ull;
+    }
+    return hash;
+}
+
 } // namespace util
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef UTIL_HPP
 #define UTIL_HPP
 
+#include <cstddef>
+#include <cstdint>
+
 #include <SFML/Graphics/Color.hpp>
 #include <SFML/System/Vector3.hpp>
 #include <glm/glm.hpp>
@@ -13,6 +16,10 @@ namespace util
 sf::Color vector_to_color(sf::Vector3f vector);
 geometry::Ray transform_ray(const glm::mat4& matrix, glm::vec3 camera_origin, glm::vec3 pixel_position);
 
+// 64-bit FNV-1a, stable across runs; pass a previous result as hash to chain several values
+constexpr std::uint64_t hash_seed{14695981039346656037ull};
+std::uint64_t hash_bytes(const void* data, std::size_t size, std::uint64_t hash = hash_seed);
+
 } // namespace util
 
 #endif // UTIL_HPP
\ No newline at end of file
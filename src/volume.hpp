@@ -1,16 +1,24 @@
 #ifndef VOLUME_HPP
 #define VOLUME_HPP
 
+#include <cmath>
+
 #include <SFML/System/Vector3.hpp>
 
 namespace volume
 {
 
-float beer_lambert_transmittance(float distance, float absorption_coeff);
+inline float beer_lambert_transmittance(float distance, float absorption_coeff)
+{
+    return std::exp(-distance * absorption_coeff);
+}
 
-sf::Vector3f volume_scattering(float transmittance, const sf::Vector3f& background,
-                               const sf::Vector3f& volume = sf::Vector3f{0.0f, 0.0f, 0.0f});
+inline sf::Vector3f volume_scattering(float transmittance, const sf::Vector3f& background,
+                                      const sf::Vector3f& volume = sf::Vector3f{0.0f, 0.0f, 0.0f})
+{
+    return (transmittance * background) + (1.0f - transmittance) * volume;
+}
 
 } // namespace volume
 
-#endif // VOLUME_HPP
\ No newline at end of file
+#endif // VOLUME_HPP